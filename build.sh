@@ -1,25 +1,32 @@
 project_name=hex
 
 sources=$(find src -name "*.c")
+# the engine knows nothing about curses or the network, it is compiled
+# without them and also put into libhive.a
+library_sources=$(echo $(find src -name "hive*.c" ! -name "hive_ui.c") \
+	src/point_list.c)
+# tests that only need the engine, they are compiled like the library and
+# linked against libhive.a alone
+headless_tests="perft solve"
+headless_source=
 headers=$(find src -name "*.h")
 rebuild=false
 objects=
-program="build/$project_name"
+library_objects=
+build_dir=build
+program=$project_name
 do_execute=false
 do_linking=false
 do_debug=false
 
 common_flags="-g -fdiagnostics-plain-output"
-# -Ibuild needs to be included so that gcc can find the .gch file
-compiler_flags="$common_flags -Werror -Wall -Wextra -Ibuild"
+compiler_flags="$common_flags -Werror -Wall -Wextra"
 linker_flags="$common_flags"
-linker_libs="-lncursesw"
+linker_libs="-lncursesw -lm"
 
-options=$(getopt --options=t:xgB --longoptions=clean,test:,execute,debug,trace --name "$0" -- "$@")
+options=$(getopt --options=t:xgrB --longoptions=clean,test:,execute,debug,release,trace --name "$0" -- "$@")
 [ $? = 0 ] || exit 1
 
-mkdir -p build/tests build/src || exit
-
 eval set -- "$options"
 
 while [ $# -ne 0 ]
@@ -38,13 +45,22 @@ do
 		shift
 		;;
 	-t|--test)
-		sources="${sources/'src/main.c'/}"
-		sources="$sources tests/$2.c"
-		if [ -f tests/test.c ] && [ ! "$2" = "test" ]
-		then
-			sources="$sources tests/test.c"
-		fi
-		program=build/tests/$2
+		case " $headless_tests " in
+		*" $2 "*)
+			sources="$library_sources tests/$2.c"
+			headless_source="tests/$2.c"
+			linker_libs="-lm"
+			;;
+		*)
+			sources="${sources/'src/main.c'/}"
+			sources="$sources tests/$2.c"
+			if [ -f tests/test.c ] && [ ! "$2" = "test" ]
+			then
+				sources="$sources tests/test.c"
+			fi
+			;;
+		esac
+		program=tests/$2
 		shift 2
 		;;
 	-x|--execute)
@@ -52,10 +68,16 @@ do
 		shift
 		;;
 	-g|--debug)
-		[ ! -z "$program" ] && program=build/$project_name
 		do_debug=true
 		shift
 		;;
+	-r|--release)
+		# optimized objects go into their own directory so switching
+		# between debug and release builds does not mix objects
+		build_dir=build/release
+		compiler_flags="$compiler_flags -O2 -DNDEBUG"
+		shift
+		;;
 	--)
 		shift
 		break
@@ -66,12 +88,18 @@ do
 	esac
 done
 
+# -I$build_dir needs to be included so that gcc can find the .gch file,
+# -Isrc is the fallback for sources outside of src/ (the tests)
+compiler_flags="$compiler_flags -I$build_dir -Isrc"
+program="$build_dir/$program"
+mkdir -p $build_dir/tests $build_dir/src || exit
+
 for h in $headers
 do
-	if [ src/$project_name.h -nt build/$project_name.h.gch ] ||
-		[ $h -nt build/$project_name.h.gch ]
+	if [ src/$project_name.h -nt $build_dir/$project_name.h.gch ] ||
+		[ $h -nt $build_dir/$project_name.h.gch ]
 	then
-		gcc $compiler_flags src/$project_name.h -o build/$project_name.h.gch 2>/tmp/error_file.txt || exit
+		gcc $compiler_flags src/$project_name.h -o $build_dir/$project_name.h.gch 2>/tmp/error_file.txt || exit
 		rebuild=true
 		break
 	fi
@@ -79,17 +107,38 @@ done
 
 for s in $sources
 do
-	o="build/${s:0:-2}.o"
+	o="$build_dir/${s:0:-2}.o"
 	objects="$objects $o"
+	flags=$compiler_flags
+	case " $library_sources " in
+	*" $s "*)
+		flags="$flags -DHIVE_HEADLESS"
+		library_objects="$library_objects $o"
+		;;
+	esac
+	if [ "$s" = "$headless_source" ]
+	then
+		flags="$flags -DHIVE_HEADLESS"
+	fi
 	if [ $s -nt $o ] || $rebuild
 	then
-		gcc $compiler_flags -c $s -o $o 2>/tmp/error_file.txt || exit
+		gcc $flags -c $s -o $o 2>/tmp/error_file.txt || exit
 		do_linking=true
 	fi
 done
 
-if $do_linking || [ ! -f $project_name ]
+if $do_linking || [ ! -f $build_dir/libhive.a ]
+then
+	rm -f $build_dir/libhive.a
+	ar rcs $build_dir/libhive.a $library_objects 2>/tmp/error_file.txt || exit
+fi
+
+if $do_linking || [ ! -f $program ]
 then
+	if [ -n "$headless_source" ]
+	then
+		objects="$build_dir/${headless_source:0:-2}.o $build_dir/libhive.a"
+	fi
 	gcc $linker_flags $objects -o $program $linker_libs 2>/tmp/error_file.txt || exit
 fi
 
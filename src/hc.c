@@ -6,14 +6,14 @@ void hc_init(HiveChat *hc)
 	hc->status = newwin(1, COLS, LINES - 1, 0);
 	wbkgdset(hc->status, COLOR_PAIR(PAIR_STATUS_INFO));
 	if (hc->status == NULL ||
-			hive_init(&hc->hive, 0, 0,
-				COLS / 2 - 1, LINES - 1) < 0 ||
+			hive_init(&hc->hive) < 0 ||
 			net_chat_init(&hc->chat, COLS / 2, 0,
 				COLS - COLS / 2, LINES - 1, 10000) < 0) {
 		endwin();
 		fprintf(stderr, "failed initializing\n");
 		exit(-1);
 	}
+	hive_setposition(&hc->hive, 0, 0, COLS / 2 - 1, LINES - 1);
 }
 
 void hc_setposition(HiveChat *hc, int x, int y, int w, int h)
@@ -32,6 +32,19 @@ void hc_renderstatus(HiveChat *hc)
 	if (hc->inSync)
 		wprintw(win, "Synced with a server. ");
 	wprintw(win, "%zu moves played. ", hive->history.count);
+	switch (hive_getresult(hive)) {
+	case HIVE_ONGOING:
+		break;
+	case HIVE_BLACK_WINS:
+		wprintw(win, "Black wins. ");
+		break;
+	case HIVE_WHITE_WINS:
+		wprintw(win, "White wins. ");
+		break;
+	case HIVE_DRAW:
+		wprintw(win, "Draw. ");
+		break;
+	}
 	if (chat->net.socket > 0)
 		wprintw(win, chat->net.isServer ? "Hosting server: '%s'" :
 				"Username: '%s'", chat->name);
@@ -46,50 +59,6 @@ bool hc_hasconnection(void *ptr)
 	return hc->chat.net.socket > 0;
 }
 
-static char *hc_serializemove(const HiveMove *move)
-{
-	static char data[256];
-
-	if (snprintf(data, sizeof(data), "%s %d,%d %d,%d",
-			move->fromInventory ? "true" : "false",
-			move->from.x, move->from.y,
-			move->to.x, move->to.y) == sizeof(data))
-		return NULL;
-	return data;
-}
-
-static int hc_deserializemove(const char *data, HiveMove *move)
-{
-	if (strncmp(data, "true ", sizeof("true")) == 0) {
-		move->fromInventory = true;
-		data += sizeof("true");
-	} else if (strncmp(data, "false ", sizeof("false")) == 0) {
-		move->fromInventory = false;
-		data += sizeof("false");
-	} else {
-		return -1;
-	}
-
-	move->from.x = strtol(data, (char**) &data, 10);
-	if (*data != ',')
-		return -1;
-	data++;
-	move->from.y = strtol(data, (char**) &data, 10);
-	while (isblank(*data))
-		data++;
-
-	move->to.x = strtol(data, (char**) &data, 10);
-	if (*data != ',')
-		return -1;
-	data++;
-	move->to.y = strtol(data, (char**) &data, 10);
-	while (isblank(*data))
-		data++;
-	if (*data != '\0')
-		return -1;
-	return 0;
-}
-
 void hc_notifygamestart(void *ptr)
 {
 	(void) ptr;
@@ -103,7 +72,7 @@ int hc_notifymove(void *ptr, const HiveMove *move)
 
 	(void) ptr;
 	HiveChat *const hc = &hive_chat;
-	data = hc_serializemove(move);
+	data = hive_serializemove(move);
 	net_receiver_sendany(&hc->chat.net, 0, NET_REQUEST_HIVE_MOVE, data);
 	if (hc->chat.net.isServer)
 		hive_domove(&hc->hive, move, false);
@@ -118,7 +87,7 @@ int hc_sendmoves(void *ptr, int socket)
 	HiveChat *const hc = &hive_chat;
 	Hive *const hive = &hc->hive;
 	for (size_t i = 0; i < hive->history.count; i++) {
-		data = hc_serializemove(&hive->history.moves[i]);
+		data = hive_serializemove(&hive->history.moves[i]);
 		net_receiver_sendany(&hc->chat.net, socket,
 				NET_REQUEST_HIVE_MOVE, data);
 	}
@@ -133,23 +102,31 @@ bool hc_isplayer(void *ptr, int player)
 		(player == 1 && hc->hive.turn == HIVE_BLACK);
 }
 
+static const char *const hc_resultmessages[] = {
+	[HIVE_BLACK_WINS] = "Server> Black wins!\n",
+	[HIVE_WHITE_WINS] = "Server> White wins!\n",
+	[HIVE_DRAW] = "Server> Draw!\n",
+};
+
 int hc_domove(void *ptr, const char *data)
 {
 	HiveMove move;
+	enum hive_result result;
 
 	(void) ptr;
 	HiveChat *const hc = &hive_chat;
 	NetChat *const chat = &hc->chat;
-	if (hc_deserializemove(data, &move) < 0)
+	if (hive_deserializemove(data, &move) < 0)
 		return -1;
 	hive_domove(&hc->hive, &move, false);
-	if (hive_isqueensurrounded(&hc->hive)) {
+	/* the side to move is not necessarily the loser, a side can also
+	 * surround its own queen
+	 */
+	result = hive_getresult(&hc->hive);
+	if (result != HIVE_ONGOING) {
 		pthread_mutex_lock(&chat->output.lock);
 		wattr_set(chat->output.win, 0, PAIR_INFO, NULL);
-		waddstr(chat->output.win,
-				hc->hive.turn == HIVE_WHITE ?
-					"Server> White wins!\n" :
-					"Server> Black wins!\n");
+		waddstr(chat->output.win, hc_resultmessages[result]);
 		pthread_mutex_unlock(&chat->output.lock);
 	}
 	return 0;
@@ -24,9 +24,6 @@ extern HiveChat hive_chat;
  */
 bool hc_hasconnection(void *ptr);
 int hc_sendmoves(void *ptr, int socket);
-/* a move is in the simple format:
- * [0|1] [x position],[y position] [x position],[y position] 
- */
 /* send a notification to the server */
 int hc_notifymove(void *ptr, const HiveMove *move);
 bool hc_isplayer(void *ptr, int player);
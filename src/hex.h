@@ -3,14 +3,35 @@
 
 #include <assert.h>
 #include <ctype.h>
-#include <curses.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <locale.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/* the engine is compiled with HIVE_HEADLESS for libhive.a, it only ever
+ * holds on to the windows of a region and never touches them
+ */
+#ifdef HIVE_HEADLESS
+typedef struct _win_st WINDOW;
+#else
+#include <curses.h>
+#endif
+
 #define MIN(a, b) ({ \
 	__auto_type _a = (a); \
 	__auto_type _b = (b); \
@@ -24,6 +45,7 @@
 })
 
 #define ARRLEN(a) (sizeof(a)/sizeof*(a))
+#ifndef HIVE_HEADLESS
 #define ASSERT(p, msg) do { \
 	if (!(p)) { \
 		endwin(); \
@@ -33,6 +55,7 @@
 } while (0)
 
 void curses_init(void);
+#endif
 
 typedef struct point {
 	int x, y;
@@ -83,7 +106,9 @@ enum {
 #define COLOR(fg, bg) (1 + (fg) + (bg) * 8)
 
 #include "hive.h"
+#ifndef HIVE_HEADLESS
 #include "net.h"
 #include "hc.h"
+#endif
 
 #endif
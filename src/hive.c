@@ -38,15 +38,28 @@ void hive_pointtogrid(Point *point, Point translation)
 	point->y = (point->y - (point->x & 1)) / 2;
 }
 
+bool hive_move_isequal(const HiveMove *a, const HiveMove *b)
+{
+	return a->fromInventory == b->fromInventory &&
+		a->isThrow == b->isThrow &&
+		point_isequal(a->from, b->from) &&
+		point_isequal(a->to, b->to);
+}
+
 void hive_move_list_push(HiveMoveList *list, const HiveMove *move)
 {
 	HiveMove *newMoves;
+	size_t newCapacity;
 
-	newMoves = realloc(list->moves, sizeof(*list->moves) *
-			(list->count + 1));
-	if (newMoves == NULL)
-		return;
-	list->moves = newMoves;
+	if (list->count == list->capacity) {
+		newCapacity = list->capacity * 2 + 16;
+		newMoves = realloc(list->moves, sizeof(*list->moves) *
+				newCapacity);
+		if (newMoves == NULL)
+			return;
+		list->moves = newMoves;
+		list->capacity = newCapacity;
+	}
 	list->moves[list->count++] = *move;
 }
 
@@ -65,6 +78,23 @@ void hive_move_list_clear(HiveMoveList *list)
 	list->count = 0;
 }
 
+void hive_undo_list_push(HiveUndoList *list, const HiveUndo *undo)
+{
+	HiveUndo *newUndos;
+	size_t newCapacity;
+
+	if (list->count == list->capacity) {
+		newCapacity = list->capacity * 2 + 16;
+		newUndos = realloc(list->undos, sizeof(*list->undos) *
+				newCapacity);
+		if (newUndos == NULL)
+			return;
+		list->undos = newUndos;
+		list->capacity = newCapacity;
+	}
+	list->undos[list->count++] = *undo;
+}
+
 static const HivePiece default_black_pieces[] = {
 	{ .side = HIVE_BLACK, .type = HIVE_ANT, .position = { 5, 1 } },
 	{ .side = HIVE_BLACK, .type = HIVE_ANT, .position = { 6, 1 } },
@@ -99,893 +129,425 @@ static const HivePiece default_white_pieces[] = {
 	{ .side = HIVE_WHITE, .type = HIVE_SPIDER, .position = { 7, 0 } },
 };
 
-int hive_init(Hive *hive, int x, int y, int w, int h)
+int hive_init(Hive *hive)
 {
-	Point cur;
-
 	memset(hive, 0, sizeof(*hive));
 	memcpy(&hive->allPieces[ARRLEN(default_white_pieces)],
 			default_black_pieces, sizeof(default_black_pieces));
 	memcpy(hive->allPieces,
 			default_white_pieces, sizeof(default_white_pieces));
+	hive->board.hasGraph = true;
 
-	hive_region_init(&hive->blackInventory, x, y + h - h / 5, w, h / 5);
 	for (size_t i = 0; i < ARRLEN(default_black_pieces); i++)
 		hive_region_addpiece(&hive->blackInventory,
 			&hive->allPieces[ARRLEN(default_black_pieces) + i]);
-
-	hive_region_init(&hive->whiteInventory, x, y, w, h / 5);
 	for (size_t i = 0; i < ARRLEN(default_white_pieces); i++)
 		hive_region_addpiece(&hive->whiteInventory,
 				&hive->allPieces[i]);
-
-	hive_region_init(&hive->board, x, y + h / 5, w, h - 2 * (h / 5));
-	cur = (Point) { w / 2, h / 4 };
-	hive_pointtogrid(&cur, hive->board.translation);
-	hive->hexCursor = cur;
+	hive->hash = hive_computehash(hive);
+	hive_eval_compute(hive, &hive->eval);
+	hive_nnue_refresh(hive);
 	return 0;
 }
 
-void hive_setposition(Hive *hive, int x, int y, int w, int h)
+/* puts the piece back into its inventory at the cell it started on, the
+ * pieces of an inventory must not share a cell; the inventory has to be
+ * reindexed after the last one
+ */
+static void hive_returnpiece(Hive *hive, HivePiece *piece)
 {
-	Point cur;
-
-	delwin(hive->blackInventory.win);
-	delwin(hive->board.win);
-	delwin(hive->whiteInventory.win);
-	hive->blackInventory.win = newwin(h / 5, w, y + h - h / 5, x);
-	hive->whiteInventory.win = newwin(h / 5, w, y, x);
-	hive->board.win = newwin(h - 2 * (h / 5), w, y + h / 5, x);
-	cur = (Point) { w / 2, h / 4 };
-	hive_pointtogrid(&cur, hive->board.translation);
-	hive->hexCursor = cur;
+	const size_t index = piece - hive->allPieces;
+
+	piece->position = index < ARRLEN(default_white_pieces) ?
+		default_white_pieces[index].position :
+		default_black_pieces[index -
+			ARRLEN(default_white_pieces)].position;
+	hive_region_stackpiece(piece->side == HIVE_WHITE ?
+			&hive->whiteInventory : &hive->blackInventory, piece);
 }
 
 void hive_reset(Hive *hive)
 {
 	for (size_t i = 0; i < ARRLEN(hive->regions); i++)
-		hive->regions[i].numPieces = 0;
+		hive_region_clear(&hive->regions[i]);
 
-	for (size_t i = 0; i < ARRLEN(default_black_pieces); i++)
-		hive_region_addpiece(&hive->blackInventory,
-				&hive->allPieces[ARRLEN(default_black_pieces) + i]);
-	for (size_t i = 0; i < ARRLEN(default_white_pieces); i++)
-		hive_region_addpiece(&hive->whiteInventory,
-				&hive->allPieces[i]);
+	for (size_t i = 0; i < HIVE_PIECE_COUNT; i++) {
+		hive->allPieces[i].flags = 0;
+		hive_returnpiece(hive, &hive->allPieces[i]);
+	}
+	for (size_t i = 0; i < ARRLEN(hive->regions); i++)
+		hive_region_reindex(&hive->regions[i]);
 	hive->selectedPiece = NULL;
 	hive->turn = HIVE_BLACK;
 	hive->moves.count = 0;
 	hive->choices.count = 0;
 	hive->history.count = 0;
+	hive->undos.count = 0;
+	hive->hash = hive_computehash(hive);
+	hive_eval_compute(hive, &hive->eval);
+	hive_nnue_refresh(hive);
+	hive_cache_clear(hive);
 }
 
-struct keeper {
-	Point start;
-	HivePiece *piece;
-	bool addAll;
-	bool needsPivot;
-	PointList visited;
-	uint32_t distance;
-	int fromDirection;
-};
-
-/* note: pos is the position that is already moved towards dir */
-static bool hive_canmoveto(Hive *hive, Point pos, int dir, bool needsPivot)
+static HivePiece *hive_rebasepiece(Hive *dest, const Hive *src,
+		const HivePiece *piece)
 {
-	HivePiece *at;
-	HivePiece *pieces[6];
-	HivePiece *front[2];
-
-	/* make sure to not pass through pieces */
-	at = hive_region_pieceat(&hive->board, NULL, pos);
-	if (at != NULL)
-		return false;
-
-	/* check if moving there would isolate the piece */
-	if (hive_region_getsurrounding(&hive->board, pos, pieces) == 1)
-		return false;
-
-	switch (dir) {
-	case HIVE_NORTH:
-		front[0] = pieces[HIVE_SOUTH_EAST];
-		front[1] = pieces[HIVE_SOUTH_WEST];
-		break;
-	case HIVE_SOUTH:
-		front[0] = pieces[HIVE_NORTH_EAST];
-		front[1] = pieces[HIVE_NORTH_WEST];
-		break;
-	case HIVE_NORTH_EAST:
-		front[0] = pieces[HIVE_SOUTH];
-		front[1] = pieces[HIVE_NORTH_WEST];
-		break;
-	case HIVE_NORTH_WEST:
-		front[0] = pieces[HIVE_SOUTH];
-		front[1] = pieces[HIVE_NORTH_EAST];
-		break;
-	case HIVE_SOUTH_EAST:
-		front[0] = pieces[HIVE_NORTH];
-		front[1] = pieces[HIVE_SOUTH_WEST];
-		break;
-	case HIVE_SOUTH_WEST:
-		front[0] = pieces[HIVE_NORTH];
-		front[1] = pieces[HIVE_SOUTH_EAST];
-		break;
-	}
-	/* check if the piece can pass through */
-	if (front[0] != NULL && front[1] != NULL)
-		return false;
-	/* check if there is a pivot to move around
-	 * (not every piece like the queen needs a pivot to move)
-	 */
-	if (needsPivot && front[0] == NULL && front[1] == NULL)
-		return false;
-	return true;
+	return piece == NULL ? NULL :
+		&dest->allPieces[piece - src->allPieces];
 }
 
-static void hive_moveexhaustive_recursive(Hive *hive, struct keeper *k)
+int hive_copy(Hive *dest, const Hive *src)
 {
-	Point pos;
+	HiveUndo undo;
 
-	const int od = hive_oppositedirection(k->fromDirection);
-	for (int d = 0; d < 6; d++) {
-		if (d == od)
-			continue;
-		pos = k->piece->position;
-		hive_movepoint(&pos, d);
-		if (point_list_contains(&k->visited, pos))
-			continue;
-		if (!hive_canmoveto(hive, pos, d, k->needsPivot))
-			continue;
-		point_list_push(&k->visited, pos);
-		if (k->distance == 1 || k->addAll)
-			point_list_push(&hive->moves, pos);
-		if (k->distance > 1) {
-			const Point origPos = k->piece->position;
-			const int origFromDir = k->fromDirection;
-			k->piece->position = pos;
-			k->distance--;
-			k->fromDirection = d;
-			hive_moveexhaustive_recursive(hive, k);
-			k->fromDirection = origFromDir;
-			k->distance++;
-			k->piece->position = origPos;
+	memcpy(dest, src, sizeof(*dest));
+	/* the pieces are referred to by pointers everywhere, they must point
+	 * into the pieces of the copy
+	 */
+	for (size_t i = 0; i < ARRLEN(dest->regions); i++) {
+		HiveRegion *const region = &dest->regions[i];
+		region->win = NULL;
+		for (size_t p = 0; p < region->numPieces; p++)
+			region->pieces[p] = hive_rebasepiece(dest, src,
+					region->pieces[p]);
+		for (size_t c = 0; c < HIVE_CELL_COUNT; c++) {
+			HiveCell *const cell = &region->cells[c];
+			for (uint32_t l = 0; l < cell->count; l++)
+				cell->stack[l] = hive_rebasepiece(dest, src,
+						cell->stack[l]);
 		}
 	}
-}
-
-void hive_moveexhaustive(Hive *hive, HivePiece *piece, bool addAll,
-		bool needsPivot, uint32_t dist)
-{
-	struct keeper k;
-
-	memset(&k, 0, sizeof(k));
-	point_list_push(&k.visited, piece->position);
-	k.start = piece->position;
-	k.piece = piece;
-	k.addAll = addAll;
-	k.needsPivot = needsPivot;
-	k.distance = dist;
-	k.fromDirection = -1;
-	hive_moveexhaustive_recursive(hive, &k);
-	free(k.visited.points);
-}
-
-static void hive_computemovesant(Hive *hive)
-{
-	hive_moveexhaustive(hive, hive->selectedPiece, true, false, UINT32_MAX);
-}
-
-/* note: pos is the position that is already moved towards dir */
-static bool hive_canmoveontop(Hive *hive, Point pos, int dir)
-{
-	HivePiece *pieces[6];
-	Point prevPos;
-	HivePiece *front[3];
-	int cnts[3];
-	int cnt;
-
-	prevPos = pos;
-	hive_movepoint(&prevPos, hive_oppositedirection(dir));
-	if (hive_region_getsurrounding(&hive->board, pos, pieces) == 1 &&
-			hive_region_countat(&hive->board, prevPos) == 1)
-		return false;
-
-	front[1] = hive_region_pieceat(&hive->board, NULL, pos);
-	switch (dir) {
-	case HIVE_NORTH:
-		front[0] = pieces[HIVE_SOUTH_EAST];
-		front[2] = pieces[HIVE_SOUTH_WEST];
-		break;
-	case HIVE_SOUTH:
-		front[0] = pieces[HIVE_NORTH_EAST];
-		front[2] = pieces[HIVE_NORTH_WEST];
-		break;
-	case HIVE_NORTH_EAST:
-		front[0] = pieces[HIVE_SOUTH];
-		front[2] = pieces[HIVE_NORTH_WEST];
-		break;
-	case HIVE_NORTH_WEST:
-		front[0] = pieces[HIVE_SOUTH];
-		front[2] = pieces[HIVE_NORTH_EAST];
-		break;
-	case HIVE_SOUTH_EAST:
-		front[0] = pieces[HIVE_NORTH];
-		front[2] = pieces[HIVE_SOUTH_WEST];
-		break;
-	case HIVE_SOUTH_WEST:
-		front[0] = pieces[HIVE_NORTH];
-		front[2] = pieces[HIVE_SOUTH_EAST];
-		break;
-	}
-
-	for (uint32_t i = 0; i < ARRLEN(front); i++)
-		cnts[i] = front[i] == NULL ? 0 :
-			hive_region_countat(&hive->board, front[i]->position);
-	hive_movepoint(&pos, hive_oppositedirection(dir));
-	cnt = hive_region_countat(&hive->board, pos);
-	return MAX(cnts[1], cnt) >= MIN(cnts[0], cnts[2]);
-}
-
-static void hive_computemovesbeetle(Hive *hive)
-{
-	Point pos;
-
-	for (int d = 0; d < 6; d++) {
-		pos = hive->selectedPiece->position;
-		hive_movepoint(&pos, d);
-		if (!hive_canmoveontop(hive, pos, d))
-			continue;
-		point_list_push(&hive->moves, pos);
+	dest->actor = hive_rebasepiece(dest, src, src->actor);
+	dest->selectedPiece = hive_rebasepiece(dest, src, src->selectedPiece);
+	if (src->selectedRegion != NULL)
+		dest->selectedRegion = &dest->regions[src->selectedRegion -
+			src->regions];
+
+	memset(&dest->moves, 0, sizeof(dest->moves));
+	memset(&dest->choices, 0, sizeof(dest->choices));
+	memset(&dest->legalMoves, 0, sizeof(dest->legalMoves));
+	memset(&dest->history, 0, sizeof(dest->history));
+	memset(&dest->undos, 0, sizeof(dest->undos));
+	for (size_t i = 0; i < src->history.count; i++)
+		hive_move_list_push(&dest->history, &src->history.moves[i]);
+	for (size_t i = 0; i < src->undos.count; i++) {
+		undo = src->undos.undos[i];
+		undo.piece = hive_rebasepiece(dest, src, undo.piece);
+		undo.immobile = hive_rebasepiece(dest, src, undo.immobile);
+		hive_undo_list_push(&dest->undos, &undo);
+	}
+	if (dest->history.count != src->history.count ||
+			dest->undos.count != src->undos.count) {
+		hive_free(dest);
+		return -1;
 	}
+	return 0;
 }
 
-static void hive_computemovesgrasshopper(Hive *hive)
+void hive_free(Hive *hive)
 {
-	Point pos;
-	uint32_t cnt;
-
-	for (int d = 0; d < 6; d++) {
-		pos = hive->selectedPiece->position;
-		cnt = 0;
-		do {
-			cnt++;
-			hive_movepoint(&pos, d);
-		} while (hive_region_pieceat(&hive->board, NULL, pos) != NULL);
-		if (cnt == 1)
-			continue;
-		point_list_push(&hive->moves, pos);
-	}
+	free(hive->moves.points);
+	free(hive->choices.points);
+	free(hive->legalMoves.moves);
+	free(hive->history.moves);
+	free(hive->undos.undos);
 }
 
-struct hive_ladybug_keeper {
-	Point start;
-	HivePiece *piece;
-	uint32_t numRemaining;
-};
-
-static void hive_findmovesladybug(Hive *hive, struct hive_ladybug_keeper *lk)
+void hive_getstate(const Hive *hive, HiveState *state)
 {
-	Point pos;
-	HivePiece *pieces[6];
-	HivePiece *piece;
-
-	hive_region_getsurroundingr(&hive->board, lk->piece->position, pieces);
-	for (int d = 0; d < 6; d++) {
-		pos = lk->piece->position;
-		hive_movepoint(&pos, d);
-		if (point_isequal(lk->start, pos))
-			continue;
-		piece = pieces[d];
-		switch (lk->numRemaining) {
-		/* move over two non null pieces */
-		case 3:
-		case 2:
-			if (piece == NULL)
-				continue;
-			if (!hive_canmoveontop(hive, pos, d))
-				continue;
-			break;
-		/* drop down */
-		case 1:
-			if (piece != NULL)
-				continue;
-			if (!hive_canmoveontop(hive, pos, d))
-				continue;
-			point_list_push(&hive->moves, pos);
-			break;
-		}
+	const HiveRegion *const board = &hive->board;
 
-		if (lk->numRemaining > 0) {
-			const Point orig = lk->piece->position;
-			lk->piece->position = pos;
-			lk->numRemaining--;
-			hive_findmovesladybug(hive, lk);
-			lk->numRemaining++;
-			lk->piece->position = orig;
+	memset(state, 0, sizeof(*state));
+	for (size_t i = 0; i < HIVE_PIECE_COUNT; i++)
+		state->pieces[i].level = HIVE_STATE_INVENTORY;
+	state->turn = hive->turn;
+	state->immobile = HIVE_STATE_NONE;
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &board->cells[i];
+		for (uint32_t l = 0; l < cell->count; l++) {
+			const size_t p = cell->stack[l] - hive->allPieces;
+			state->pieces[p].x = cell->position.x;
+			state->pieces[p].y = cell->position.y;
+			state->pieces[p].level = l;
+			if (cell->stack[l]->flags & HIVE_IMMOBILE)
+				state->immobile = p;
 		}
 	}
 }
 
-static void hive_computemovesladybug(Hive *hive)
-{
-	struct hive_ladybug_keeper lk;
-
-	memset(&lk, 0, sizeof(lk));
-	lk.start = hive->selectedPiece->position;
-	lk.piece = hive->selectedPiece;
-	lk.numRemaining = 3;
-	hive_findmovesladybug(hive, &lk);
-}
-
-static void hive_computemovesmosquito(Hive *hive)
-{
-	HivePiece *pieces[6];
-
-	if (hive_region_getbelow(&hive->board, hive->selectedPiece) != NULL) {
-		hive_computemovesbeetle(hive);
-		return;
-	}
-	hive_region_getsurroundingr(&hive->board, hive->selectedPiece->position,
-			pieces);
-	for (int d = 0; d < 6; d++) {
-		HivePiece *const piece = pieces[d];
-		if (piece == NULL || piece->type == HIVE_MOSQUITO)
-			continue;
-		point_list_push(&hive->choices, piece->position);
-	}
-}
-
-static void hive_computemovespillbug(Hive *hive)
+int hive_setstate(Hive *hive, const HiveState *state)
 {
-	HivePiece *pieces[6];
-
-	/* get the normal moves */
-	hive_moveexhaustive(hive, hive->selectedPiece, false, false, 1);
-	hive_region_getsurroundingr(&hive->board, hive->selectedPiece->position,
-			pieces);
-	for (int d = 0; d < 6; d++) {
-		HivePiece *const piece = pieces[d];
-		if (piece == NULL)
-			continue;
-		/* can't carry an immobile moved piece */
-		if (piece->flags & HIVE_IMMOBILE)
-			continue;
-		/* can only carry pieces not in a stack */
-		if (hive_region_getbelow(&hive->board, piece) != NULL ||
-				!hive_canmoveontop(hive,
-					hive->selectedPiece->position,
-					hive_oppositedirection(d)))
-			continue;
-		point_list_push(&hive->choices, piece->position);
-	}
-}
+	if (state->turn > HIVE_WHITE || (state->immobile != HIVE_STATE_NONE &&
+			(state->immobile >= HIVE_PIECE_COUNT ||
+			 state->pieces[state->immobile].level ==
+			 HIVE_STATE_INVENTORY)))
+		return -1;
+	for (size_t i = 0; i < HIVE_PIECE_COUNT; i++)
+		if (state->pieces[i].level != HIVE_STATE_INVENTORY &&
+				state->pieces[i].level >= HIVE_STACK_SIZE)
+			return -1;
 
-static void hive_computemovespillbug_carrying(Hive *hive)
-{
-	HivePiece *pieces[6];
-	Point pos;
-
-	/* we assume that the piece has move on top of the pillbug */
-	/* we can't just set the position if stacks are involved */
-	const Point orig = hive->selectedPiece->position;
-	hive_region_removepiece(&hive->board, hive->selectedPiece);
-	hive->selectedPiece->position = hive->actor->position;
-	hive_region_addpiece(&hive->board, hive->selectedPiece);
-
-	hive_region_getsurrounding(&hive->board, hive->actor->position, pieces);
-	for (int d = 0; d < 6; d++) {
-		HivePiece *const piece = pieces[d];
-		if (piece != NULL)
-			continue;
-		pos = hive->actor->position;
-		hive_movepoint(&pos, d);
-		if (point_isequal(pos, orig))
-			continue;
-		if (!hive_canmoveontop(hive, pos, d))
-			continue;
-		point_list_push(&hive->moves, pos);
-	}
-	hive_region_removepiece(&hive->board, hive->selectedPiece);
-	hive->selectedPiece->position = orig;
-	hive_region_addpiece(&hive->board, hive->selectedPiece);
-}
-
-static void hive_computemovesqueen(Hive *hive)
-{
-	hive_moveexhaustive(hive, hive->selectedPiece, false, false, 1);
-}
-
-static void hive_computemovesspider(Hive *hive)
-{
-	hive_moveexhaustive(hive, hive->selectedPiece, false, true, 3);
-}
-
-static bool hive_canmoveaway(Hive *hive)
-{
-	size_t i;
-	HivePiece *piece;
-	HivePiece *pieces[6];
-	int dir;
-
-	/* check if the queen was placed already */
-	for (i = 0; i < hive->board.numPieces; i++) {
-		piece = hive->board.pieces[i];
-		if (piece->type == HIVE_QUEEN && piece->side == hive->turn)
-			break;
-	}
-	if (i == hive->board.numPieces)
-		return false;
-	piece = hive->selectedPiece;
-	if (hive_region_getbelow(&hive->board, piece) != NULL)
-		return true;
-	/* check if this would break the hive */
-	hive_region_clearflags(&hive->board, HIVE_VISITED);
-	piece->flags |= HIVE_VISITED;
-	/* pick any direction to go in */
-	dir = -1;
-	hive_region_getsurrounding(&hive->board, piece->position, pieces);
-	for (int d = 0; d < 6; d++)
-		if (pieces[d] != NULL) {
-			dir = d;
-			break;
+	for (size_t i = 0; i < ARRLEN(hive->regions); i++)
+		hive_region_clear(&hive->regions[i]);
+	for (size_t i = 0; i < HIVE_PIECE_COUNT; i++) {
+		HivePiece *const piece = &hive->allPieces[i];
+		piece->flags = 0;
+		if (state->pieces[i].level == HIVE_STATE_INVENTORY)
+			hive_returnpiece(hive, piece);
+	}
+	/* the stacks are built from the bottom up */
+	for (uint32_t l = 0; l < HIVE_STACK_SIZE; l++)
+		for (size_t i = 0; i < HIVE_PIECE_COUNT; i++) {
+			HivePiece *const piece = &hive->allPieces[i];
+			if (state->pieces[i].level != l)
+				continue;
+			piece->position = (Point) {
+				state->pieces[i].x,
+				state->pieces[i].y,
+			};
+			if (hive_region_countat(&hive->board,
+					piece->position) != l) {
+				hive_reset(hive);
+				return -1;
+			}
+			hive_region_stackpiece(&hive->board, piece);
 		}
-	if (dir == -1)
-		/* there are no pieces to move */
-		return false;
-	piece = pieces[dir];
-	return hive_region_count(&hive->board, piece) ==
-		hive->board.numPieces - 1;
-}
-
-bool hive_isqueensurrounded(Hive *hive)
-{
-	HivePiece *pieces[6];
-
-	for (size_t i = 0; i < hive->board.numPieces; i++) {
-		HivePiece *const piece = hive->board.pieces[i];
-		if (piece->side == hive->turn && piece->type == HIVE_QUEEN)
-			return hive_region_getsurrounding(&hive->board,
-					piece->position, pieces) == 6;
-	}
-	return false;
-}
-
-void hive_computemoves(Hive *hive, enum hive_type type)
-{
-	static void (*const computes[])(Hive *hive) = {
-		[HIVE_ANT] = hive_computemovesant,
-		[HIVE_BEETLE] = hive_computemovesbeetle,
-		[HIVE_GRASSHOPPER] = hive_computemovesgrasshopper,
-		[HIVE_LADYBUG] = hive_computemovesladybug,
-		[HIVE_MOSQUITO] = hive_computemovesmosquito,
-		[HIVE_PILLBUG] = hive_computemovespillbug,
-		[HIVE_PILLBUG_CARRYING] = hive_computemovespillbug_carrying,
-		[HIVE_QUEEN] = hive_computemovesqueen,
-		[HIVE_SPIDER] = hive_computemovesspider,
-	};
-	bool wouldBreak;
-
-	point_list_clear(&hive->moves);
-	point_list_clear(&hive->choices);
-	if (hive_isqueensurrounded(hive))
-		return;
-	/* we have to check for the pillbug because it has
-	 * the option to not move itself
-	 */
-	wouldBreak = !hive_canmoveaway(hive);
-	if (!wouldBreak || type == HIVE_PILLBUG)
-		computes[type](hive);
-	if (wouldBreak)
-		hive->moves.count = 0;
-}
-
-static bool hive_canplace(Hive *hive, Point pos)
-{
-	HivePiece *pieces[6];
-	bool affirm;
+	/* the graph and the masks are built once all pieces are in */
+	for (size_t i = 0; i < ARRLEN(hive->regions); i++)
+		hive_region_reindex(&hive->regions[i]);
+	if (state->immobile != HIVE_STATE_NONE)
+		hive->allPieces[state->immobile].flags |= HIVE_IMMOBILE;
 
-	if (hive->board.numPieces == 0)
-		return true;
-	if (hive_region_pieceat(&hive->board, NULL, pos) != NULL)
-		return false;
-	if (hive_region_getsurroundingr(&hive->board, pos, pieces) == 1 &&
-			hive->board.numPieces == 1)
-		return true;
-	affirm = false;
-	for (int d = 0; d < 6; d++) {
-		HivePiece *const piece = pieces[d];
-		if (piece == NULL)
-			continue;
-		if (piece->side != hive->turn)
-			return false;
-		if (piece->side == hive->turn)
-			affirm = true;
-	}
-	return affirm;
+	hive->turn = state->turn;
+	hive->actor = NULL;
+	hive->selectedPiece = NULL;
+	hive->moves.count = 0;
+	hive->choices.count = 0;
+	hive->history.count = 0;
+	hive->undos.count = 0;
+	hive->hash = hive_computehash(hive);
+	hive_eval_compute(hive, &hive->eval);
+	hive_nnue_refresh(hive);
+	hive_cache_clear(hive);
+	return 0;
 }
 
-static void hive_computeplaces(Hive *hive)
+enum hive_result hive_getresult(const Hive *hive)
 {
-	Point pos;
+	const bool black = hive_issurrounded(hive, HIVE_BLACK);
+	const bool white = hive_issurrounded(hive, HIVE_WHITE);
+	uint32_t seen;
 
-	point_list_clear(&hive->moves);
-	point_list_clear(&hive->choices);
-	for (size_t i = 0; i < hive->board.numPieces; i++) {
-		HivePiece *const piece = hive->board.pieces[i];
-		if (piece->side != hive->turn && hive->board.numPieces > 1)
-			continue;
-		for (int d = 0; d < 6; d++) {
-			pos = piece->position;
-			hive_movepoint(&pos, d);
-			if (!hive_canplace(hive, pos))
-				continue;
-			point_list_push(&hive->moves, pos);
-		}
-	}
+	if (black && white)
+		return HIVE_DRAW;
+	if (black)
+		return HIVE_WHITE_WINS;
+	if (white)
+		return HIVE_BLACK_WINS;
+	/* the current position is the first time it was seen */
+	seen = 1;
+	for (size_t i = 0; i < hive->undos.count; i++)
+		if (hive->undos.undos[i].hash == hive->hash && ++seen == 3)
+			return HIVE_DRAW;
+	return HIVE_ONGOING;
 }
 
 static bool hive_hasanymoves(Hive *hive)
 {
-	if (hive->board.numPieces <= 3)
-		return true;
-	if (hive_getinventory(hive)->numPieces > 0) {
-		hive_computeplaces(hive);
-		if (hive->moves.count > 0)
-			return true;
-	}
+	hive_generatemoves(hive, &hive->cache, &hive->legalMoves);
+	return hive->legalMoves.count > 0;
+}
+
+void hive_makemove(Hive *hive, const HiveMove *move, HiveUndo *undo)
+{
+	HiveRegion *const region = move->fromInventory ?
+		hive_getinventory(hive) : &hive->board;
+	HivePiece *const piece = hive_region_pieceatr(region, NULL, move->from);
+	size_t index;
+
+	for (index = 0; region->pieces[index] != piece; index++)
+		(void) 0;
+	undo->piece = piece;
+	undo->from = move->from;
+	undo->region = region - hive->regions;
+	undo->index = index;
+	undo->level = hive_region_countat(region, move->from) - 1;
+	undo->vertex = region == &hive->board ?
+		hive_region_vertexat(region, move->from) : 0;
+	undo->turn = hive->turn;
+	undo->immobile = NULL;
+	undo->hash = hive->hash;
+	undo->numChanges = hive->cache.numChanges;
+	memcpy(undo->mobility, hive->eval.mobility, sizeof(undo->mobility));
 	for (size_t i = 0; i < hive->board.numPieces; i++) {
-		HivePiece *const piece = hive->board.pieces[i];
-		if (piece->side != hive->turn)
-			continue;
-		hive->selectedPiece = piece;
-		hive_computemoves(hive, piece->type);
-		if (hive->moves.count > 0) {
-			hive->selectedPiece = NULL;
-			return true;
-		}
-		if (hive->choices.count == 0 || piece->type != HIVE_PILLBUG)
-			continue;
-		const size_t cnt = hive->choices.count;
-		for (size_t c = 0; c < cnt; c++) {
-			hive->selectedPiece =
-				hive_region_pieceatr(&hive->board, NULL,
-						hive->choices.points[c]);
-			hive_computemoves(hive, HIVE_PILLBUG_CARRYING);
-			if (hive->moves.count > 0) {
-				hive->selectedPiece = NULL;
-				return true;
-			}
+		HivePiece *const p = hive->board.pieces[i];
+		if (p->flags & HIVE_IMMOBILE) {
+			undo->immobile = p;
+			p->flags &= ~HIVE_IMMOBILE;
+			hive->hash ^= hive_hash_immobile(p->position);
 		}
 	}
-	hive->selectedPiece = NULL;
-	return false;
-}
 
-static void hive_selectpiece(Hive *hive, HiveRegion *region, HivePiece *piece)
-{
-	if (hive->actor != NULL) {
-		hive->actor->flags &= ~HIVE_ISACTOR;
-		hive->actor = NULL;
-	}
-	if (hive->selectedPiece != NULL) {
-		hive->selectedPiece->flags &= ~HIVE_SELECTED;
-		if (hive->selectedPiece == piece) {
-			hive->selectedPiece = NULL;
-			return;
-		}
-	}
-	if (piece == NULL || piece->side != hive->turn) {
-		hive->selectedPiece = NULL;
-		return;
-	}
-	hive->selectedRegion = region;
-	hive->selectedPiece = piece;
-	piece->flags |= HIVE_SELECTED;
-	if (piece->flags & HIVE_IMMOBILE) {
-		point_list_clear(&hive->moves);
-		point_list_clear(&hive->choices);
-		return;
-	}
+	if (region == &hive->board)
+		hive_eval_toggle(hive, move->from);
+	hive_eval_toggle(hive, move->to);
 	if (region == &hive->board) {
-		hive_computemoves(hive, piece->type);
+		hive->hash ^= hive_hash_piece(piece, move->from, undo->level);
+		hive_region_movepiece(&hive->board, piece, move->to);
 	} else {
-		if (piece->type != HIVE_QUEEN) {
-			size_t cnt;
-			bool hasQueen;
-
-			/* count the number of pieces of this side to
-			 * check if the queen needs to be placed */
-			cnt = 0;
-			hasQueen = false;
-			for (size_t i = 0; i < hive->board.numPieces; i++) {
-				HivePiece *const piece = hive->board.pieces[i];
-				if (piece->side != hive->turn)
-					continue;
-				if (piece->type == HIVE_QUEEN) {
-					hasQueen = true;
-					break;
-				}
-				cnt++;
-			}
-			/* cnt == 3 means that three turns were played already,
-			 * meaning the queen has to be placed now
-			 */
-			if (!hasQueen && cnt == 3)
-				return;
-		}
-		hive_computeplaces(hive);
-	}
-}
-
-void hive_domove(Hive *hive, const HiveMove *move, bool doNotify)
-{
-	if (doNotify && hc_hasconnection(hive)) {
-		hc_notifymove(hive, move);
+		const uint32_t cnt = hive_hash_countinventory(region,
+				piece->type);
+		hive->hash ^= hive_hash_inventory(piece->side, piece->type,
+				cnt) ^ hive_hash_inventory(piece->side,
+					piece->type, cnt - 1);
+		hive_region_removepiece(region, piece);
+		piece->position = move->to;
+		hive_region_addpiece(&hive->board, piece);
+	}
+	hive_eval_update(hive, piece, move->from, region == &hive->board,
+			move->to, true, NULL);
+	hive_nnue_update(hive, piece, move->from, region == &hive->board,
+			move->to, true);
+	hive_cache_update(hive, move->from, region == &hive->board,
+			move->to, true);
+	hive->hash ^= hive_hash_piece(piece, move->to,
+			hive_region_countat(&hive->board, move->to) - 1);
+	/* this happens when a pillbug just moved a piece */
+	if (move->isThrow) {
+		piece->flags |= HIVE_IMMOBILE;
+		hive->hash ^= hive_hash_immobile(move->to);
+	}
+	hive->turn = hive->turn == HIVE_WHITE ? HIVE_BLACK : HIVE_WHITE;
+	hive->hash ^= hive_hash_turn();
+}
+
+void hive_undomove(Hive *hive, const HiveUndo *undo)
+{
+	HiveRegion *const region = &hive->regions[undo->region];
+	HivePiece *const piece = undo->piece;
+	const Point at = piece->position;
+
+	piece->flags &= ~HIVE_IMMOBILE;
+	hive_eval_toggle(hive, at);
+	if (region == &hive->board) {
+		hive_eval_toggle(hive, undo->from);
+		/* only the top of a stack moves, so it goes back on top */
+		hive_region_movepiece(&hive->board, piece, undo->from);
+		assert(hive_region_countat(region, undo->from) ==
+				(size_t) undo->level + 1);
+		/* the cell may have come back with the lowest free vertex */
+		if (undo->level == 0)
+			hive_region_setvertex(&hive->board, undo->from,
+					undo->vertex);
 	} else {
-		hive->selectedRegion = move->fromInventory ?
-			hive_getinventory(hive) : &hive->board;
-		hive->selectedPiece = hive_region_pieceatr(hive->selectedRegion,
-				NULL, move->from);
-		hive_region_removepiece(hive->selectedRegion,
-				hive->selectedPiece);
-		hive->selectedPiece->position = move->to;
-		hive_region_addpiece(&hive->board, hive->selectedPiece);
-		hive->turn = hive->turn == HIVE_WHITE ? HIVE_BLACK : HIVE_WHITE;
-		for (size_t i = 0; i < hive->board.numPieces; i++) {
-			HivePiece *const piece = hive->board.pieces[i];
-			piece->flags &= ~HIVE_IMMOBILE;
-		}
-		/* this happens when a beetle just moved a piece */
-		if (hive->actor != NULL)
-			hive->selectedPiece->flags |= HIVE_IMMOBILE;
-		hive_move_list_push(&hive->history, move);
-		if (!hive_hasanymoves(hive))
-			hive->turn = hive->turn == HIVE_WHITE ? HIVE_BLACK :
-				HIVE_WHITE;
+		hive_region_removepiece(&hive->board, piece);
+		piece->position = undo->from;
+		hive_region_insertpiece(region, undo->index, piece);
 	}
-	hive_selectpiece(hive, NULL, NULL);
+	hive_eval_update(hive, piece, at, true, undo->from,
+			region == &hive->board, undo->mobility);
+	hive_nnue_update(hive, piece, at, true, undo->from,
+			region == &hive->board);
+	if (undo->immobile != NULL)
+		undo->immobile->flags |= HIVE_IMMOBILE;
+	hive->turn = undo->turn;
+	hive->hash = undo->hash;
+	hive->cache.numChanges = undo->numChanges;
 }
 
-static bool hive_transferpiece(Hive *hive, HiveRegion *region, Point pos)
+void hive_playmove(Hive *hive, const HiveMove *move)
 {
-	HiveRegion *inventory;
-	HiveMove move;
+	HiveUndo undo;
 
-	if (hive->selectedPiece == NULL || region != &hive->board)
-		return false;
-	inventory = hive_getinventory(hive);
-	move.fromInventory = hive->selectedRegion == inventory;
-	move.from = hive->selectedPiece->position;
-	move.to = pos;
-	hive->selectedPiece->flags &= ~HIVE_SELECTED;
-	if (point_list_contains(&hive->moves, pos) ||
-			hive->board.numPieces == 0) {
-		hive_domove(hive, &move, true);
-		return true;
-	}
-	if (point_list_contains(&hive->choices, pos)) {
-		HivePiece *const piece =
-			hive_region_pieceatr(&hive->board, NULL, pos);
-		if (hive->selectedPiece->type == HIVE_MOSQUITO &&
-				/* if the actor is not null, the
-				 * mosquito is trying to mimic a pillbug
-				 */
-				hive->actor == NULL) {
-			hive->actor = hive->selectedPiece;
-			hive->actor->flags |= HIVE_ISACTOR;
-			hive_computemoves(hive, piece->type);
-		} else {
-			hive->actor = hive->selectedPiece;
-			hive->actor->flags |= HIVE_ISACTOR;
-			hive->selectedPiece->flags &= ~HIVE_SELECTED;
-			hive->selectedPiece = piece;
-			piece->flags |= HIVE_SELECTED;
-			hive_computemoves(hive, HIVE_PILLBUG_CARRYING);
-		}
-		return true;
+	hive_makemove(hive, move, &undo);
+	hive_move_list_push(&hive->history, move);
+	hive_undo_list_push(&hive->undos, &undo);
+	if (!hive_hasanymoves(hive)) {
+		hive->turn = hive->turn == HIVE_WHITE ? HIVE_BLACK :
+			HIVE_WHITE;
+		hive->hash ^= hive_hash_turn();
 	}
-	return false;
 }
 
-static HiveRegion *hive_getregionat(Hive *hive, Point at)
+bool hive_takeback(Hive *hive)
 {
-	for (size_t i = 0; i < ARRLEN(hive->regions); i++) {
-		Point pos;
-
-		HiveRegion *const region = &hive->regions[i];
-		pos = at;
-		if (wmouse_trafo(region->win, &pos.y, &pos.x, false))
-			return region;
-	}
-	return NULL;
+	if (hive->undos.count == 0)
+		return false;
+	hive_undomove(hive, &hive->undos.undos[--hive->undos.count]);
+	hive->history.count--;
+	return true;
 }
 
-static void hive_pressposition(Hive *hive, HiveRegion *region, Point pos)
+char *hive_serializemove(const HiveMove *move)
 {
-	HivePiece *piece;
+	static char data[256];
 
-	if (!hive_transferpiece(hive, region, pos)) {
-		piece = hive_region_pieceatr(region, NULL, pos);
-		hive_selectpiece(hive, region, piece);
-	}
+	if (snprintf(data, sizeof(data), "%s %d,%d %d,%d%s",
+			move->fromInventory ? "true" : "false",
+			move->from.x, move->from.y,
+			move->to.x, move->to.y,
+			move->isThrow ? " throw" : "") == sizeof(data))
+		return NULL;
+	return data;
 }
 
-bool hive_handlemousepress(Hive *hive, int button, Point mouse)
+int hive_deserializemove(const char *data, HiveMove *move)
 {
-	HiveRegion *region;
-	Point pos;
-
-	region = hive_getregionat(hive, mouse);
-	if (region == NULL) {
-		hive_selectpiece(hive, NULL, NULL);
-		return false;
-	}
-	pos = mouse;
-	wmouse_trafo(region->win, &pos.y, &pos.x, false);
-	hive_pointtogrid(&pos, region->translation);
-	switch (button) {
-	case 0:
-		hive_pressposition(hive, region, pos);
-		break;
-	}
-	return true;
+	if (strncmp(data, "true ", sizeof("true")) == 0) {
+		move->fromInventory = true;
+		data += sizeof("true");
+	} else if (strncmp(data, "false ", sizeof("false")) == 0) {
+		move->fromInventory = false;
+		data += sizeof("false");
+	} else {
+		return -1;
+	}
+
+	move->from.x = strtol(data, (char**) &data, 10);
+	if (*data != ',')
+		return -1;
+	data++;
+	move->from.y = strtol(data, (char**) &data, 10);
+	while (isblank(*data))
+		data++;
+
+	move->to.x = strtol(data, (char**) &data, 10);
+	if (*data != ',')
+		return -1;
+	data++;
+	move->to.y = strtol(data, (char**) &data, 10);
+	while (isblank(*data))
+		data++;
+	move->isThrow = strncmp(data, "throw", sizeof("throw") - 1) == 0;
+	if (move->isThrow)
+		data += sizeof("throw") - 1;
+	if (*data != '\0')
+		return -1;
+	return 0;
 }
 
-static void hive_selectnexttype(Hive *hive, HiveRegion *region,
-		enum hive_type type)
+int hive_loadmoves(Hive *hive, char *moves, char **bad)
 {
-	HivePiece *cur;
+	HiveMove move;
 	size_t i;
 
-	cur = hive->selectedPiece;
-	if (region != hive->selectedRegion)
-		cur = NULL;
-	if (cur != NULL) {
-		for (i = 0; i < region->numPieces; i++)
-			if (region->pieces[i] == cur)
-				break;
-		for (i++; i < region->numPieces; i++) {
-			HivePiece *const piece = region->pieces[i];
-			if (hive_region_getabove(region, piece) != NULL)
-				continue;
-			if (piece->side != hive->turn || piece->type != type)
-				continue;
-			hive_selectpiece(hive, region, piece);
-			return;
-		}
-	}
-
-	for (i = 0; i < region->numPieces; i++) {
-		HivePiece *const piece = region->pieces[i];
-		if (piece == cur)
-			break;
-		if (hive_region_getabove(region, piece) != NULL)
+	for (char *data = strtok(moves, ";\n"); data != NULL;
+			data = strtok(NULL, ";\n")) {
+		while (isblank(*data))
+			data++;
+		if (*data == '\0')
 			continue;
-		if (piece->side != hive->turn || piece->type != type)
-			continue;
-		hive_selectpiece(hive, region, piece);
-		break;
-	}
-}
-
-int hive_handle(Hive *hive, int c)
-{
-	static const struct {
-		char key;
-		enum hive_type type;
-	} keyTypeMap[] = {
-		{ 'a', HIVE_ANT },
-		{ 'b', HIVE_BEETLE },
-		{ 'g', HIVE_GRASSHOPPER },
-		{ 'l', HIVE_LADYBUG },
-		{ 'm', HIVE_MOSQUITO },
-		{ 'p', HIVE_PILLBUG },
-		{ 'q', HIVE_QUEEN },
-		{ 's', HIVE_SPIDER },
-	};
-	HiveRegion *region;
-
-	if (hive->selectedRegion == NULL)
-		hive->selectedRegion = &hive->board;
-	region = hive->selectedRegion;
-	switch (c) {
-	case '0':
-		if (hive->selectedPiece != NULL) {
-			hive->hexCursor.x = 0;
-			hive->hexCursor.y = 0;
-		} else {
-			region->translation.x = 0;
-			region->translation.y = 0;
-		}
-		break;
-	case KEY_LEFT:
-		if (hive->selectedPiece != NULL)
-			hive->hexCursor.x--;
-		else
-			region->translation.x--;
-		break;
-	case KEY_RIGHT:
-		if (hive->selectedPiece != NULL)
-			hive->hexCursor.x++;
-		else
-			region->translation.x++;
-		break;
-	case KEY_UP:
-		if (hive->selectedPiece != NULL)
-			hive->hexCursor.y--;
-		else
-			region->translation.y--;
-		break;
-	case KEY_DOWN:
-		if (hive->selectedPiece != NULL)
-			hive->hexCursor.y++;
-		else
-			region->translation.y++;
-		break;
-
-	case '\n':
-	case '\r':
-		if (hive->selectedPiece != NULL)
-			hive_pressposition(hive, &hive->board, hive->hexCursor);
-		break;
-
-	case 'a' ... 'z':
-	case 'A' ... 'Z':
-		for (size_t i = 0; i < ARRLEN(keyTypeMap); i++)
-			if (keyTypeMap[i].key == tolower(c)) {
-				hive_selectnexttype(hive,
-						islower(c) ? &hive->board :
-							hive_getinventory(hive),
-						keyTypeMap[i].type);
+		*bad = data;
+		if (hive_deserializemove(data, &move) < 0)
+			return -1;
+		hive_generatemoves(hive, &hive->cache, &hive->legalMoves);
+		for (i = 0; i < hive->legalMoves.count; i++)
+			if (hive_move_isequal(&hive->legalMoves.moves[i],
+						&move))
 				break;
-			}
-		break;
-
-	case 0x1b:
-		hive_selectpiece(hive, NULL, NULL);
-		break;
+		if (i == hive->legalMoves.count)
+			return -1;
+		hive_playmove(hive, &move);
 	}
 	return 0;
 }
-
-void hive_render(Hive *hive)
-{
-	Point p;
-	size_t cnt;
-
-	for (size_t i = 0; i < ARRLEN(hive->regions); i++)
-		hive_region_render(&hive->regions[i]);
-	if (hive->selectedPiece == NULL)
-		return;
-	hive_region_renderhexat(&hive->board, COLOR_MAGENTA, hive->hexCursor);
-	wattr_set(hive->board.win, 0, COLOR(COLOR_BLACK, COLOR_YELLOW), NULL);
-	for (size_t i = 0; i < hive->moves.count; i++) {
-		p = hive->moves.points[i];
-		hive_pointtoworld(&p, hive->board.translation);
-		mvwaddstr(hive->board.win, p.y, p.x + 1, "   ");
-		mvwaddstr(hive->board.win, p.y + 1, p.x + 1, "   ");
-	}
-	wattr_set(hive->board.win, 0, COLOR(COLOR_BLACK, COLOR_GREEN), NULL);
-	for (size_t i = 0; i < hive->choices.count; i++) {
-		p = hive->choices.points[i];
-		hive_pointtoworld(&p, hive->board.translation);
-		mvwaddstr(hive->board.win, p.y, p.x + 1, "   ");
-		mvwaddstr(hive->board.win, p.y + 1, p.x + 1, "   ");
-	}
-	if (hive->selectedRegion != &hive->board) {
-		wnoutrefresh(hive->board.win);
-		return;
-	}
-	/* render the piece stack */
-	getmaxyx(hive->board.win, p.y, p.x);
-	p.y = 0;
-	p.x -= 7;
-	cnt = hive_region_countat(&hive->board, hive->selectedPiece->position);
-	for (HivePiece *piece = hive->selectedPiece; piece != NULL;
-			piece = hive_region_getbelow(&hive->board, piece)) {
-		hive_region_renderpieceat(&hive->board, piece, cnt, p);
-		cnt--;
-		p.y += 3;
-	}
-	wnoutrefresh(hive->board.win);
-}
@@ -36,6 +36,34 @@ enum {
 	HIVE_ABOVE, HIVE_BELOW
 };
 
+/* the two cells a piece has to pass between when moving in a direction,
+ * relative to the cell it moves to
+ */
+extern const int hive_gates[6][2];
+
+#define HIVE_SLIDE_FREE (1 << 0)
+#define HIVE_SLIDE_PIVOT (1 << 1)
+/* indexed by the direction of a slide and the occupied neighbors of the
+ * cell slid into (bit d is set if the neighbor in direction d is
+ * occupied, the moving piece counts for the cell it comes from);
+ * HIVE_SLIDE_FREE is set if the piece fits through and keeps contact,
+ * HIVE_SLIDE_PIVOT if it also has a piece to move around
+ */
+extern uint8_t hive_slides[6][64];
+
+/* the most pieces on a single cell: one on the ground with all beetles and
+ * mosquitos on top of it, rounded up
+ */
+#define HIVE_STACK_SIZE 8
+
+#define HIVE_CLIMB_HEIGHTS HIVE_STACK_SIZE
+#define hive_climbheight(h) MIN((size_t) (h), (size_t) HIVE_CLIMB_HEIGHTS - 1)
+/* indexed by the heights of the cell climbed from, the cell climbed to and
+ * the two gate cells
+ */
+extern bool hive_climbs[HIVE_CLIMB_HEIGHTS][HIVE_CLIMB_HEIGHTS]
+	[HIVE_CLIMB_HEIGHTS][HIVE_CLIMB_HEIGHTS];
+
 #define hive_oppositedirection(d) ({ \
 	int o; \
 	switch (d) { \
@@ -57,39 +85,178 @@ typedef struct hive_piece {
 	Point position;
 } HivePiece;
 
+/* must be a power of two and well above HIVE_PIECE_COUNT so that the
+ * probe sequences stay short
+ */
+#define HIVE_CELL_COUNT 64
+
+/* a slot in the open-addressed cell index of a region, a slot with
+ * count == 0 is free
+ */
+typedef struct hive_cell {
+	Point position;
+	uint32_t count;
+	/* vertex of the cell in the graph of the region */
+	uint32_t vertex;
+	/* the pieces from the bottom up */
+	HivePiece *stack[HIVE_STACK_SIZE];
+} HiveCell;
+
+/* the occupied cells of a region and which of them touch, every occupied
+ * cell has a vertex number for as long as it stays occupied;
+ * the biconnected components (blocks) are kept up to date with each
+ * added or removed vertex, only the blocks around that vertex change
+ */
+typedef struct hive_graph {
+	uint64_t vertices;
+	/* vertices with more than one piece on them */
+	uint64_t stacked;
+	uint64_t adjacent[HIVE_CELL_COUNT];
+	bool isConnected;
+	uint64_t blocks[HIVE_CELL_COUNT];
+	uint32_t numBlocks;
+	/* vertices that are part of more than one block */
+	uint64_t cuts;
+} HiveGraph;
+
+/* the bitboards cover a window of 32x32 cells in axial coordinates
+ * (q = x, r = y - floor(x / 2)), bit q * 32 + r is the cell at (q, r)
+ * relative to the origin of the window;
+ * a hive of 28 connected cells spans at most 28 cells along each axis,
+ * so together with the ring of neighbors and a guard cell on each side
+ * it always fits
+ */
+#define HIVE_BITBOARD_SIZE 32
+#define HIVE_BITBOARD_WORDS (HIVE_BITBOARD_SIZE * HIVE_BITBOARD_SIZE / 64)
+/* number of tracked stack heights */
+#define HIVE_BITBOARD_HEIGHTS 4
+
+typedef struct hive_bitboard {
+	uint64_t words[HIVE_BITBOARD_WORDS];
+} HiveBitboard;
+
+typedef struct hive_masks {
+	/* false if the pieces do not fit into the window, all users must
+	 * fall back to the cell index then
+	 */
+	bool valid;
+	/* axial coordinates of bit 0 */
+	Point origin;
+	/* heights[h] has all cells with more than h pieces */
+	HiveBitboard heights[HIVE_BITBOARD_HEIGHTS];
+	/* cells where the top piece belongs to that side */
+	HiveBitboard sides[2];
+} HiveMasks;
+
 typedef struct hive_region {
 	WINDOW *win;
 	Point translation;
 	HivePiece *pieces[HIVE_PIECE_COUNT];
 	size_t numPieces;
+	/* maps a position to the stack of pieces on it */
+	HiveCell cells[HIVE_CELL_COUNT];
+	/* only the board keeps the masks and the graph, the inventories are
+	 * never searched for moves and leave them empty
+	 */
+	bool hasGraph;
+	HiveMasks masks;
+	HiveGraph graph;
 } HiveRegion;
 
-int hive_region_init(HiveRegion *region, int x, int y, int w, int h);
+void hive_bitboard_neighbors(const HiveBitboard *b, HiveBitboard *out);
+/* floods from the set bits of seed through the set bits of within */
+void hive_bitboard_flood(const HiveBitboard *seed, const HiveBitboard *within,
+		HiveBitboard *out);
+#define hive_bitboard_isset(b, bit) \
+	(((b)->words[(bit) / 64] >> ((bit) % 64)) & 1)
+bool hive_bitboard_isequal(const HiveBitboard *a, const HiveBitboard *b);
+size_t hive_bitboard_count(const HiveBitboard *b);
+
+/* the offset of the bit of the neighbor in each direction */
+extern const int hive_bitoffsets[6];
+
+bool hive_masks_bitof(const HiveMasks *masks, Point at, size_t *bit);
+Point hive_masks_pointof(const HiveMasks *masks, size_t bit);
+void hive_masks_rebuild(HiveMasks *masks, const HiveCell *cells);
+void hive_masks_update(HiveMasks *masks, const HiveCell *cells,
+		const HiveCell *cell, Point at);
+/* all empty cells next to the given side and not next to the other side */
+void hive_masks_placements(const HiveMasks *masks, enum hive_side side,
+		HiveBitboard *out);
+/* checks if all occupied cells are still connected when the top piece at
+ * the given position is lifted
+ */
+bool hive_masks_isconnectedwithout(const HiveMasks *masks, Point at);
+/* the occupied neighbors of a cell as mask like hive_slides uses it,
+ * fails if the cell is not well inside of the window
+ */
+bool hive_masks_neighbors(const HiveMasks *masks, Point at, uint32_t *mask);
+void hive_masks_topoints(const HiveMasks *masks, const HiveBitboard *b,
+		PointList *list);
+
+/* adds a vertex connected to the given vertices and returns it */
+uint32_t hive_graph_addvertex(HiveGraph *graph, uint64_t neighbors);
+void hive_graph_removevertex(HiveGraph *graph, uint32_t vertex);
+/* gives a vertex another number that is not in use */
+void hive_graph_movevertex(HiveGraph *graph, uint32_t from, uint32_t to);
+/* finds all blocks from scratch */
+void hive_graph_recompute(HiveGraph *graph);
+/* all vertices that split the graph when removed, these are all vertices
+ * if the graph is not connected to begin with
+ */
+uint64_t hive_graph_articulations(const HiveGraph *graph);
+/* the vertices whose piece can't move away without breaking the hive */
+uint64_t hive_graph_pinned(const HiveGraph *graph);
+
+void hive_region_clear(HiveRegion *region);
 int hive_region_addpiece(HiveRegion *region, HivePiece *piece);
+/* puts the piece at the given index of the pieces of the region */
+int hive_region_insertpiece(HiveRegion *region, size_t index,
+		HivePiece *piece);
+/* adds the piece on top of the stack at its position without updating
+ * the graph and the masks, for filling a region in one go;
+ * hive_region_reindex must follow before the region is used
+ */
+int hive_region_stackpiece(HiveRegion *region, HivePiece *piece);
+/* builds the graph and the masks from the cells */
+void hive_region_reindex(HiveRegion *region);
 int hive_region_removepiece(HiveRegion *region, HivePiece *piece);
+/* pieces that are part of a region must be moved with this function
+ * so that the cell index stays in sync, the piece lands on top of
+ * the destination stack
+ */
+int hive_region_movepiece(HiveRegion *region, HivePiece *piece, Point to);
 
 /* the little 'r' stands for "reverse" */
-HivePiece *hive_region_pieceat(HiveRegion *region, HivePiece *from, Point at);
-HivePiece *hive_region_pieceatr(HiveRegion *region, HivePiece *from, Point at);
-size_t hive_region_getsurrounding(HiveRegion *region, Point at,
+HivePiece *hive_region_pieceat(const HiveRegion *region,
+		const HivePiece *from, Point at);
+HivePiece *hive_region_pieceatr(const HiveRegion *region,
+		const HivePiece *from, Point at);
+size_t hive_region_getsurrounding(const HiveRegion *region, Point at,
 		HivePiece *pieces[6]);
-size_t hive_region_getsurroundingr(HiveRegion *region, Point at,
+size_t hive_region_getsurroundingr(const HiveRegion *region, Point at,
 		HivePiece *pieces[6]);
-size_t hive_region_countat(HiveRegion *region, Point at);
+size_t hive_region_countat(const HiveRegion *region, Point at);
+/* the vertex of the cell at the given position or -1 if it is empty */
+int hive_region_vertexat(const HiveRegion *region, Point at);
+/* gives the cell at the given position a vertex that is not in use */
+void hive_region_setvertex(HiveRegion *region, Point at, uint32_t vertex);
+/* the cell at the given position or NULL if it is empty */
+const HiveCell *hive_region_cellat(const HiveRegion *region, Point at);
 #define hive_region_getabove(region, piece) ({ \
-	HivePiece *const _piece = (piece); \
+	const HivePiece *const _piece = (piece); \
 	HivePiece *const _p = hive_region_pieceat(region, _piece, _piece->position); \
 	_p; \
 })
 #define hive_region_getbelow(region, piece) ({ \
-	HivePiece *const _piece = (piece); \
+	const HivePiece *const _piece = (piece); \
 	HivePiece *const _p = hive_region_pieceatr(region, _piece, _piece->position); \
 	_p; \
 })
 
-void hive_region_setposition(HiveRegion *region, int x, int y, int w, int h);
 void hive_region_clearflags(HiveRegion *region, uint64_t flags);
 uint32_t hive_region_count(HiveRegion *region, HivePiece *origin);
+/* the rendering lives in hive_ui.c and is not part of libhive.a */
 void hive_region_renderhexat(HiveRegion *region, short fg, Point at);
 void hive_region_renderpieceat(HiveRegion *region, HivePiece *piece,
 		size_t cnt, Point at);
@@ -98,6 +265,10 @@ void hive_region_render(HiveRegion *region);
 
 typedef struct hive_move {
 	bool fromInventory;
+	/* the piece at `from` is carried by a pillbug (or a mosquito
+	 * copying one) and can not move on the next turn
+	 */
+	bool isThrow;
 	Point from;
 	Point to;
 } HiveMove;
@@ -105,12 +276,148 @@ typedef struct hive_move {
 typedef struct hive_move_list {
 	HiveMove *moves;
 	size_t count;
+	size_t capacity;
 } HiveMoveList;
 
+bool hive_move_isequal(const HiveMove *a, const HiveMove *b);
 void hive_move_list_push(HiveMoveList *list, const HiveMove *move);
 bool hive_move_list_contains(const HiveMoveList *list, Point from, Point to);
 void hive_move_list_clear(HiveMoveList *list);
 
+/* everything hive_makemove changes that can not be told from the position
+ * after the move
+ */
+typedef struct hive_undo {
+	HivePiece *piece;
+	Point from;
+	/* index of the region the piece came from in hive->regions */
+	uint8_t region;
+	/* where the piece was in the pieces of that region */
+	uint8_t index;
+	/* where the piece was in its stack */
+	uint8_t level;
+	/* the vertex of the cell the piece left, a cell that is occupied
+	 * again gets it back so that all vertices stay the same
+	 */
+	uint8_t vertex;
+	enum hive_side turn;
+	/* the piece that was thrown the move before, if any */
+	HivePiece *immobile;
+	/* hash of the position before the move */
+	uint64_t hash;
+	/* the changes of the move cache before the move, undoing the move
+	 * takes its changes back
+	 */
+	uint64_t numChanges;
+	/* the mobility of the evaluation before the move, with the vertices
+	 * back in place it is copied back instead of counted again
+	 */
+	uint8_t mobility[HIVE_CELL_COUNT];
+} HiveUndo;
+
+typedef struct hive_undo_list {
+	HiveUndo *undos;
+	size_t count;
+	size_t capacity;
+} HiveUndoList;
+
+void hive_undo_list_push(HiveUndoList *list, const HiveUndo *undo);
+
+/* The parts of the evaluation that would need a pass over the board,
+ * hive_makemove and hive_undomove only touch the two cells of the move.
+ * The pinned pieces come from the graph of the board and the pieces left
+ * from the inventories, both are kept up to date anyway.
+ * The move generation also reads the queens and the counts from here
+ * instead of looking for them.
+ */
+typedef struct hive_eval_state {
+	/* vertices whose top piece is of a side and type */
+	uint64_t tops[2][HIVE_PILLBUG_CARRYING];
+	/* the empty cells next to each vertex a piece on the ground could
+	 * slide into, only valid for the vertices of the board; a move only
+	 * changes them up to two cells away from a cell that became empty
+	 * or occupied
+	 */
+	uint8_t mobility[HIVE_CELL_COUNT];
+	/* the cell of each vertex of the board */
+	Point positions[HIVE_CELL_COUNT];
+	bool hasQueen[2];
+	Point queens[2];
+	/* occupied cells around each queen, 6 minus these are its liberties */
+	uint32_t queenNeighbors[2];
+	/* the side of the piece on top of each queen or -1 */
+	int coveredBy[2];
+	/* the pieces of each side on the board */
+	uint32_t placed[2];
+	/* the pieces of each side and type left in the inventory */
+	uint8_t inventory[2][HIVE_PILLBUG_CARRYING];
+} HiveEvalState;
+
+/* the cells up to this far from a queen are seen by the network */
+#define HIVE_NNUE_RADIUS 3
+#define HIVE_NNUE_CELLS 37
+/* a piece of a side (own or other) and type on a cell around a queen */
+#define HIVE_NNUE_FEATURES (2 * HIVE_PILLBUG_CARRYING * HIVE_NNUE_CELLS)
+#define HIVE_NNUE_HIDDEN 64
+#define HIVE_NNUE_HIDDEN2 32
+
+/* the first layer of the network from the view of each queen, only the
+ * pieces that move change it
+ */
+typedef struct hive_nnue_accumulator {
+	int16_t values[2][HIVE_NNUE_HIDDEN];
+} HiveNnueAccumulator;
+
+/* the changes to the board the move cache remembers */
+#define HIVE_CACHE_CHANGES 16
+/* an ant has the most moves, the perimeter of the hive */
+#define HIVE_CACHE_MOVES (2 * HIVE_PIECE_COUNT + 8)
+
+/* the moves of an ant, spider or ladybug itself, they stay valid until
+ * the board changes within the reach of the type of the piece
+ */
+typedef struct hive_cache_entry {
+	bool valid;
+	uint8_t count;
+	Point position;
+	/* the number of changes at the time the moves were generated */
+	uint64_t stamp;
+	/* the serial of the change right before the stamp; undone moves
+	 * give their stamps to the next move, this tells them apart
+	 */
+	uint64_t epoch;
+	Point to[HIVE_CACHE_MOVES];
+} HiveCacheEntry;
+
+typedef struct hive_move_cache {
+	/* the changes that led to the position, hive_undomove goes back to
+	 * the number before the move
+	 */
+	uint64_t numChanges;
+	/* all changes ever logged, never goes back */
+	uint64_t numSerials;
+	struct hive_cache_change {
+		/* the number of changes before this one, a deeper line
+		 * that was undone may have put a later change into the slot
+		 */
+		uint64_t index;
+		uint64_t serial;
+		Point at;
+		/* the cell became empty or occupied instead of just higher or
+		 * lower
+		 */
+		bool occupancy;
+	} changes[HIVE_CACHE_CHANGES];
+	HiveCacheEntry entries[HIVE_PIECE_COUNT];
+	/* generates the moves on every hit anyway and counts the hits that
+	 * differ
+	 */
+	bool verify;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t mismatches;
+} HiveMoveCache;
+
 typedef struct hive {
 	union {
 		struct {
@@ -127,7 +434,27 @@ typedef struct hive {
 	enum hive_side turn;
 	PointList moves;
 	PointList choices;
+	/* scratch list for the move generator */
+	HiveMoveList legalMoves;
 	HiveMoveList history;
+	/* one entry for each move in the history, their hashes are the
+	 * hashes of all previous positions
+	 */
+	HiveUndoList undos;
+	/* zobrist hash of the position, kept up to date by
+	 * hive_makemove
+	 */
+	uint64_t hash;
+	/* also kept up to date by hive_makemove */
+	HiveEvalState eval;
+	/* only valid while a network is loaded */
+	HiveNnueAccumulator nnue;
+	/* the changes are logged by hive_makemove, the move generator only
+	 * uses it when it is passed in; it pays off where the same pieces are
+	 * asked for again a move later, like in the UI, a search jumps around
+	 * too much for it
+	 */
+	HiveMoveCache cache;
 	/* cursor for keyboard only controls */
 	Point hexCursor;
 } Hive;
@@ -138,12 +465,546 @@ typedef struct hive {
 		&hive->blackInventory; \
 })
 
-int hive_init(Hive *hive, int x, int y, int w, int h);
+enum hive_result {
+	HIVE_ONGOING,
+	HIVE_BLACK_WINS,
+	HIVE_WHITE_WINS,
+	HIVE_DRAW,
+};
+
+/* where a piece is in a HiveState */
+typedef struct hive_state_piece {
+	int16_t x;
+	int16_t y;
+	/* the height in its stack or HIVE_STATE_INVENTORY */
+	uint8_t level;
+	uint8_t reserved;
+} HiveStatePiece;
+
+#define HIVE_STATE_INVENTORY 0xff
+#define HIVE_STATE_NONE 0xff
+
+/* A game position without any pointers and without padding, so it can be
+ * copied with memcpy and compared with memcmp; the pieces are in the order
+ * of `Hive.allPieces`, so two pieces of the same type that swapped places
+ * make a different state. It has no history, repetitions are not seen
+ * across it.
+ */
+typedef struct hive_state {
+	HiveStatePiece pieces[HIVE_PIECE_COUNT];
+	uint8_t turn;
+	/* the index of the piece that was just thrown or HIVE_STATE_NONE */
+	uint8_t immobile;
+} HiveState;
+
+int hive_init(Hive *hive);
+/* gives the game its windows, a game that should be rendered needs this
+ * after hive_init
+ */
 void hive_setposition(Hive *hive, int x, int y, int w, int h);
 void hive_reset(Hive *hive);
-bool hive_isqueensurrounded(Hive *hive);
+/* a copy of the game that shares no memory with the original, so that
+ * another thread can work on it; it has no windows and can't be rendered
+ */
+int hive_copy(Hive *dest, const Hive *src);
+void hive_free(Hive *hive);
+void hive_getstate(const Hive *hive, HiveState *state);
+/* puts the pieces where the state has them and forgets the history and
+ * the selection; returns -1 if the state is not a valid position
+ */
+int hive_setstate(Hive *hive, const HiveState *state);
+/* checks if the queen of the side to move is surrounded */
+bool hive_isqueensurrounded(const Hive *hive);
+bool hive_issurrounded(const Hive *hive, enum hive_side side);
+/* a side wins by surrounding the other queen, surrounding both at once or
+ * reaching the same position for the third time is a draw
+ */
+enum hive_result hive_getresult(const Hive *hive);
+
+/* the keys of the zobrist hash: a piece at a height, the number of pieces
+ * of a type in an inventory, the cell of the piece that was just thrown
+ * and white to move
+ */
+uint64_t hive_hash_piece(const HivePiece *piece, Point at, uint32_t level);
+uint64_t hive_hash_inventory(enum hive_side side, enum hive_type type,
+		uint32_t count);
+uint64_t hive_hash_immobile(Point at);
+uint64_t hive_hash_turn(void);
+uint32_t hive_hash_countinventory(const HiveRegion *inventory,
+		enum hive_type type);
+/* the hash from scratch */
+uint64_t hive_computehash(const Hive *hive);
+
+/* one of the twelve ways to turn and mirror the board, followed by a
+ * shift so that the position no longer depends on where it was played
+ */
+typedef struct hive_symmetry {
+	/* 0 to 5 turn by that many sixths, 6 to 11 mirror first */
+	uint32_t transform;
+	/* in axial coordinates after the transform */
+	Point origin;
+} HiveSymmetry;
+
+/* maps a cell to axial coordinates (see HIVE_BITBOARD_SIZE) */
+Point hive_symmetry_apply(const HiveSymmetry *symmetry, Point at);
+/* A hash of the position after the symmetry that gives the smallest
+ * hash, so it is the same for all positions that only differ by where
+ * they lie on the board or by turning and mirroring. The symmetry is
+ * the one that turns the position into that form, it can be NULL.
+ */
+uint64_t hive_computecanonical(const Hive *hive, HiveSymmetry *symmetry);
+
+enum hive_bound {
+	HIVE_BOUND_NONE,
+	/* the score is at most the stored one */
+	HIVE_BOUND_UPPER,
+	/* the score is at least the stored one */
+	HIVE_BOUND_LOWER,
+	HIVE_BOUND_EXACT,
+};
+
+/* what a search remembers about a position */
+typedef struct hive_table_data {
+	int score;
+	/* depth of the search, clamped to HIVE_TABLE_MAX_DEPTH */
+	uint32_t depth;
+	enum hive_bound bound;
+	bool hasMove;
+	/* coordinates must fit into a signed byte */
+	HiveMove move;
+} HiveTableData;
+
+#define HIVE_TABLE_MAX_DEPTH 63
+
+/* The key is stored xor'ed with the packed data, an entry that was torn by
+ * two threads writing at once no longer matches its key and is treated as
+ * empty. This makes locking unnecessary.
+ */
+typedef struct hive_table_entry {
+	uint64_t check;
+	uint64_t data;
+} HiveTableEntry;
+
+#define HIVE_BUCKET_SIZE 4
+
+/* one bucket fills one cache line */
+typedef struct hive_table_bucket {
+	HiveTableEntry entries[HIVE_BUCKET_SIZE];
+} __attribute__((aligned(64))) HiveTableBucket;
+
+/* A transposition table that any number of threads can probe and store
+ * into at the same time. The keys are the zobrist hashes kept in
+ * `Hive.hash`, they already cover all pieces and the side to move.
+ */
+typedef struct hive_table {
+	HiveTableBucket *buckets;
+	/* a power of two */
+	size_t numBuckets;
+	size_t size;
+	bool isMapped;
+	/* entries from older searches are replaced first */
+	uint32_t generation;
+} HiveTable;
+
+/* allocates a table of at most the given size (at least one bucket), huge
+ * pages are asked for but not required; returns -1 if there is no memory
+ */
+int hive_table_init(HiveTable *table, size_t megabytes, bool useHugePages);
+void hive_table_free(HiveTable *table);
+void hive_table_clear(HiveTable *table);
+/* entries stored after this count as newer than all before */
+void hive_table_newsearch(HiveTable *table);
+bool hive_table_probe(HiveTable *table, uint64_t key, HiveTableData *data);
+/* keeps the deepest entries of a bucket, but always replaces the entry of
+ * the same position and prefers replacing entries of older searches
+ */
+void hive_table_store(HiveTable *table, uint64_t key,
+		const HiveTableData *data);
+/* used entries of the current search per thousand, estimated from the
+ * first buckets
+ */
+uint32_t hive_table_fill(const HiveTable *table);
+
+/* The move generator only reads the position, so it can be called on any
+ * number of positions from any number of threads as long as each one has
+ * its own list. The move cache is written, so whoever passes one must be
+ * the only user of it, it may be NULL. All of these clear the list first.
+ */
+/* every legal move of the side to move: placements (one per piece type),
+ * the moves of all pieces with the mosquito copies expanded and all
+ * pillbug/mosquito throws as single moves with isThrow set
+ */
+void hive_generatemoves(const Hive *hive, HiveMoveCache *cache,
+		HiveMoveList *list);
+/* the moves of a piece on the board as if it was of the given type,
+ * including the throws it can do as the actor
+ */
+void hive_generatepiecemoves(const Hive *hive, HiveMoveCache *cache,
+		const HivePiece *piece, enum hive_type type,
+		HiveMoveList *list);
+/* placements of a piece from the inventory of the side to move */
+void hive_generateplacements(const Hive *hive, const HivePiece *piece,
+		HiveMoveList *list);
+/* all the ways the actor can throw the piece */
+void hive_generatethrows(const Hive *hive, const HivePiece *actor,
+		const HivePiece *piece, HiveMoveList *list);
+
+/* forgets all moves, this is needed after changing the board without
+ * hive_makemove or hive_undomove
+ */
+void hive_cache_clear(Hive *hive);
+/* called by hive_makemove after the piece moved */
+void hive_cache_update(Hive *hive, Point from, bool fromBoard,
+		Point to, bool toBoard);
+/* the entry of the piece if nothing within its reach changed since the
+ * moves were stored, NULL otherwise; the cache must be the one of the
+ * position, only that one sees the changes of hive_makemove
+ */
+HiveCacheEntry *hive_cache_lookup(HiveMoveCache *cache, const Hive *hive,
+		const HivePiece *piece);
+/* the moves must all be moves of the piece itself */
+void hive_cache_store(HiveMoveCache *cache, const Hive *hive,
+		const HivePiece *piece, const HiveMove *moves, size_t count);
+/* hits per lookup in percent */
+double hive_cache_hitrate(const HiveMoveCache *cache);
+
+/* the score of the position for the side to move, positive is good; it
+ * is made from the terms in `Hive.eval`, debug builds check these against
+ * hive_eval_compute
+ */
+int hive_evaluate(const Hive *hive);
+/* the same score with the terms computed from scratch */
+int hive_evaluate_full(const Hive *hive);
+void hive_eval_compute(const Hive *hive, HiveEvalState *eval);
+/* Updates the terms when a piece moves between the given cells: both
+ * cells on the board are toggled before the piece is moved and
+ * hive_eval_update is called after, it toggles them again.
+ * hive_makemove passes no mobility and it is counted again around the
+ * cells of the move, hive_undomove passes the mobility from before.
+ */
+void hive_eval_toggle(Hive *hive, Point at);
+void hive_eval_update(Hive *hive, const HivePiece *piece,
+		Point from, bool fromBoard, Point to, bool toBoard,
+		const uint8_t *mobility);
+
+/* the number of positions that go through the batch kernel at once */
+#define HIVE_BATCH_SIZE 16
+
+/* Positions side by side, one lane per position: every array has a row
+ * for each piece (in the order of `Hive.allPieces`) and a column for each
+ * position. The cells are axial coordinates relative to one of the
+ * pieces on the board, the height is 0 for a piece in the inventory and
+ * 1 for a piece on the ground.
+ */
+typedef struct hive_batch {
+	int8_t q[HIVE_PIECE_COUNT][HIVE_BATCH_SIZE];
+	int8_t r[HIVE_PIECE_COUNT][HIVE_BATCH_SIZE];
+	uint8_t heights[HIVE_PIECE_COUNT][HIVE_BATCH_SIZE];
+	/* the same in all positions */
+	uint8_t sides[HIVE_PIECE_COUNT];
+	uint8_t types[HIVE_PIECE_COUNT];
+	uint32_t count;
+} __attribute__((aligned(16))) HiveBatch;
+
+/* the terms of `Hive.eval` that need no graph, for each lane */
+typedef struct hive_batch_features {
+	int8_t queenNeighbors[2][HIVE_BATCH_SIZE];
+	int8_t coveredBy[2][HIVE_BATCH_SIZE];
+	int8_t inventory[2][HIVE_BATCH_SIZE];
+} __attribute__((aligned(16))) HiveBatchFeatures;
+
+/* takes up to HIVE_BATCH_SIZE positions, the other lanes stay empty */
+void hive_batch_load(HiveBatch *batch, const Hive *const *hives,
+		size_t count);
+void hive_batch_features(const HiveBatch *batch,
+		HiveBatchFeatures *features);
+/* loads the positions in groups and computes their features, there is one
+ * HiveBatchFeatures for every HIVE_BATCH_SIZE positions
+ */
+void hive_evaluate_batch(const Hive *const *hives, size_t count,
+		HiveBatchFeatures *features);
+
+enum hive_nnue_kernel {
+	HIVE_NNUE_SCALAR,
+	HIVE_NNUE_SSSE3,
+	HIVE_NNUE_AVX2,
+};
+
+#define HIVE_NNUE_MAGIC "HIVENNUE"
+
+/* The layout of a network file, all numbers are little endian:
+ * the header, int16 featureWeights[HIVE_NNUE_FEATURES][HIVE_NNUE_HIDDEN],
+ * int16 featureBias[HIVE_NNUE_HIDDEN],
+ * int8 hiddenWeights[HIVE_NNUE_HIDDEN2][2 * HIVE_NNUE_HIDDEN],
+ * int32 hiddenBias[HIVE_NNUE_HIDDEN2] and
+ * int8 outputWeights[HIVE_NNUE_HIDDEN2].
+ */
+typedef struct hive_nnue_header {
+	char magic[8];
+	uint32_t features;
+	uint32_t hidden;
+	uint32_t hidden2;
+	int32_t outputBias;
+	uint32_t reserved[2];
+} HiveNnueHeader;
+
+/* The accumulators of both queens, the side to move first, are clipped to
+ * 0..127 and go through a hidden layer of int8 weights, whose outputs are
+ * shifted down and clipped the same way, and then into the output.
+ */
+typedef struct hive_nnue {
+	void *map;
+	size_t size;
+	const int16_t *featureWeights;
+	const int16_t *featureBias;
+	const int8_t *hiddenWeights;
+	const int32_t *hiddenBias;
+	const int8_t *outputWeights;
+	int32_t outputBias;
+	/* the best the processor supports, set when loading */
+	enum hive_nnue_kernel kernel;
+} HiveNnue;
+
+/* there is one network for all games */
+extern HiveNnue hive_nnue;
+
+/* maps the file read only, games that exist already need
+ * hive_nnue_refresh; returns -1 if the file can't be used
+ */
+int hive_nnue_load(const char *path);
+void hive_nnue_unload(void);
+/* computes the accumulators from scratch */
+void hive_nnue_refresh(Hive *hive);
+/* called by hive_makemove and hive_undomove after hive_eval_update */
+void hive_nnue_update(Hive *hive, const HivePiece *piece,
+		Point from, bool fromBoard, Point to, bool toBoard);
+/* the score for the side to move, a network must be loaded */
+int hive_nnue_evaluate(const Hive *hive);
+
+#define HIVE_MAX_PLY 64
+/* a win in n plies scores HIVE_SCORE_MATE - n */
+#define HIVE_SCORE_MATE 30000
+#define HIVE_SCORE_INFINITE 32000
+
+/* zero means no limit, without any limit the search goes to
+ * HIVE_MAX_PLY; a search limited by nodes (or depth) alone always ends the
+ * same way when started on the same table
+ */
+typedef struct hive_search_limits {
+	double seconds;
+	uint64_t nodes;
+	uint32_t depth;
+} HiveSearchLimits;
+
+typedef struct hive_search_result {
+	/* false if the side to move has no moves */
+	bool hasMove;
+	HiveMove move;
+	int score;
+	/* the last depth that was searched completely */
+	uint32_t depth;
+	uint64_t nodes;
+	/* of all threads, each thread counts its own */
+	uint64_t tableProbes;
+	uint64_t tableHits;
+	double seconds;
+	HiveMove pv[HIVE_MAX_PLY];
+	uint32_t pvLength;
+} HiveSearchResult;
+
+struct hive_search_ply {
+	HiveMoveList moves;
+	/* the order of the moves, one for each move */
+	int *scores;
+	size_t numScores;
+	/* moves that caused a cutoff at this ply before */
+	HiveMove killers[2];
+	HiveMove pv[HIVE_MAX_PLY];
+	uint32_t pvLength;
+};
+
+/* Negamax alpha-beta with iterative deepening and principal variation
+ * search. The moves are tried in the order: the move from the table,
+ * the killer moves, then by the history of cutoffs.
+ */
+typedef struct hive_search {
+	/* a copy of the game to search on */
+	Hive hive;
+	HiveTable *table;
+	HiveSearchLimits limits;
+	double start;
+	uint64_t nodes;
+	uint64_t tableProbes;
+	uint64_t tableHits;
+	bool stop;
+	/* set by the main thread of a parallel search to stop the helpers */
+	bool *sharedStop;
+	/* 0 for the main thread, helpers start at a different depth */
+	uint32_t id;
+	struct hive_search_ply plies[HIVE_MAX_PLY + 1];
+	/* indexed by side and the low bits of the cells moved from and to */
+	int32_t history[2][64][64];
+} HiveSearch;
+
+int hive_search_init(HiveSearch *search, const Hive *hive, HiveTable *table);
+void hive_search_free(HiveSearch *search);
+void hive_search_run(HiveSearch *search, const HiveSearchLimits *limits,
+		HiveSearchResult *result);
+/* Lazy SMP: all threads search the same position and only share the
+ * table. The calling thread is the main thread, it alone watches the
+ * limits and stops the helpers once it is done; the deepest result is
+ * taken. With more than one thread, node limits are no longer
+ * deterministic.
+ */
+int hive_search_parallel(const Hive *hive, HiveTable *table,
+		uint32_t numThreads, const HiveSearchLimits *limits,
+		HiveSearchResult *result);
+
+/* a node of the monte carlo tree, the children of a node lie next to each
+ * other in the pool
+ */
+typedef struct hive_mcts_node {
+	/* the move that leads to this node */
+	HiveMove move;
+	bool isPass;
+	/* one of the HIVE_MCTS_* states */
+	uint8_t state;
+	uint32_t firstChild;
+	uint32_t numChildren;
+	/* include the playouts that are still running (virtual loss) */
+	uint32_t visits;
+	/* two for a win and one for a draw of the side that made the move */
+	uint32_t score;
+} HiveMctsNode;
+
+enum {
+	HIVE_MCTS_LEAF,
+	/* a thread is adding the children */
+	HIVE_MCTS_EXPANDING,
+	HIVE_MCTS_EXPANDED,
+	/* the pool ran out, the node stays a leaf */
+	HIVE_MCTS_FULL,
+};
+
+/* zero means no limit, without any limit the search stops once the pool
+ * is full
+ */
+typedef struct hive_mcts_limits {
+	double seconds;
+	uint64_t playouts;
+} HiveMctsLimits;
+
+typedef struct hive_mcts_result {
+	bool hasMove;
+	HiveMove move;
+	/* how often the move was tried and how well it did */
+	uint32_t visits;
+	double winRate;
+	uint64_t playouts;
+	double seconds;
+	uint32_t numNodes;
+} HiveMctsResult;
+
+/* UCT with tree parallelism: all threads walk the same tree, a node that
+ * is being played out counts as lost until the result is in, so that the
+ * threads spread out; no memory is allocated while searching
+ */
+typedef struct hive_mcts {
+	HiveMctsNode *nodes;
+	uint32_t numNodes;
+	/* never more than numNodes */
+	uint32_t usedNodes;
+	/* set once the children of a node did not fit anymore */
+	bool isFull;
+	HiveMctsLimits limits;
+	uint64_t playouts;
+	bool stop;
+} HiveMcts;
+
+int hive_mcts_init(HiveMcts *mcts, size_t megabytes);
+void hive_mcts_free(HiveMcts *mcts);
+int hive_mcts_run(HiveMcts *mcts, const Hive *hive, uint32_t numThreads,
+		const HiveMctsLimits *limits, HiveMctsResult *result);
+
+enum hive_proof {
+	/* the solver ran out of nodes */
+	HIVE_PROOF_UNKNOWN,
+	/* the side to move surrounds the other queen within the moves */
+	HIVE_PROOF_WIN,
+	/* the other side can always avoid that */
+	HIVE_PROOF_NOWIN,
+};
+
+/* proof and disproof numbers of a position at a remaining depth */
+typedef struct hive_solver_entry {
+	uint64_t key;
+	uint32_t phi;
+	uint32_t delta;
+	/* nodes spent on it, cheap entries are replaced first */
+	uint32_t work;
+} HiveSolverEntry;
+
+struct hive_solver_ply {
+	HiveMoveList moves;
+	/* the numbers of the children from the view of the side to move
+	 * there
+	 */
+	uint32_t *phi;
+	uint32_t *delta;
+	size_t capacity;
+};
+
+/* Depth-first proof-number search (df-pn) for a forced win by surrounding
+ * the queen of the other side. The entries are kept in a fixed size table
+ * that is replaced into once it is full.
+ */
+typedef struct hive_solver {
+	Hive hive;
+	HiveSolverEntry *entries;
+	size_t numEntries;
+	enum hive_side attacker;
+	uint64_t nodes;
+	uint64_t maxNodes;
+	struct hive_solver_ply plies[2 * HIVE_MAX_PLY];
+} HiveSolver;
+
+int hive_solver_init(HiveSolver *solver, size_t megabytes);
+void hive_solver_free(HiveSolver *solver);
+/* looks for a win of the side to move within the given number of its own
+ * moves, stops after maxNodes (0 is no limit); on a win, move is the
+ * first move of it
+ */
+enum hive_proof hive_solve(HiveSolver *solver, const Hive *hive,
+		uint32_t moves, uint64_t maxNodes, HiveMove *move);
+
+/* plays a legal move without any checks and without passing for a side
+ * that can not move, the undo record is all that hive_undomove needs to
+ * go back; neither allocates anything
+ */
+void hive_makemove(Hive *hive, const HiveMove *move, HiveUndo *undo);
+void hive_undomove(Hive *hive, const HiveUndo *undo);
+/* plays a legal move, keeps it in the history and passes for a side
+ * that can not move afterwards
+ */
+void hive_playmove(Hive *hive, const HiveMove *move);
+/* takes back the last move of the history */
+bool hive_takeback(Hive *hive);
+/* a move is in the simple format that is also sent over the network:
+ * [true|false] [x position],[y position] [x position],[y position] [throw]
+ */
+/* returns a static buffer */
+char *hive_serializemove(const HiveMove *move);
+int hive_deserializemove(const char *data, HiveMove *move);
+/* plays the moves separated by ';' or new lines after checking that each
+ * one is legal, on failure bad points to the move that is not
+ */
+int hive_loadmoves(Hive *hive, char *moves, char **bad);
+/* like hive_playmove but sends the move to the other side of an online
+ * game instead if doNotify is set; clears the selection
+ */
 void hive_domove(Hive *hive, const HiveMove *move, bool doNotify);
 void hive_render(Hive *hive);
+/* fills the moves and choices of the selected piece to be shown */
 void hive_computemoves(Hive *hive, enum hive_type type);
 bool hive_handlemousepress(Hive *hive, int button, Point mouse);
 int hive_handle(Hive *hive, int c);
@@ -0,0 +1,128 @@
+#include "hex.h"
+
+/* one byte for each lane, the compiler turns the operations on these into
+ * single instructions on whatever vector unit there is; comparisons give
+ * -1 where they hold and 0 where they don't
+ */
+typedef int8_t hive_lanes __attribute__((vector_size(HIVE_BATCH_SIZE)));
+
+static hive_lanes hive_batch_row(const void *row)
+{
+	hive_lanes lanes;
+
+	memcpy(&lanes, row, sizeof(lanes));
+	return lanes;
+}
+
+void hive_batch_load(HiveBatch *batch, const Hive *const *hives,
+		size_t count)
+{
+	count = MIN(count, (size_t) HIVE_BATCH_SIZE);
+	memset(batch, 0, sizeof(*batch));
+	batch->count = count;
+	for (size_t p = 0; p < HIVE_PIECE_COUNT; p++) {
+		batch->sides[p] = hives[0]->allPieces[p].side;
+		batch->types[p] = hives[0]->allPieces[p].type;
+	}
+	for (size_t l = 0; l < count; l++) {
+		const Hive *const hive = hives[l];
+		const HiveRegion *const board = &hive->board;
+		Point origin = { 0, 0 };
+		bool hasOrigin = false;
+
+		for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+			const HiveCell *const cell = &board->cells[i];
+			if (cell->count == 0)
+				continue;
+			const Point at = cell->position;
+			const int q = at.x;
+			const int r = at.y - (at.x >> 1);
+			/* the hive is small enough for bytes around any of its
+			 * cells
+			 */
+			if (!hasOrigin) {
+				origin = (Point) { q, r };
+				hasOrigin = true;
+			}
+			for (uint32_t h = 0; h < cell->count; h++) {
+				const size_t p = cell->stack[h] -
+					hive->allPieces;
+				batch->q[p][l] = q - origin.x;
+				batch->r[p][l] = r - origin.y;
+				batch->heights[p][l] = h + 1;
+			}
+		}
+	}
+}
+
+void hive_batch_features(const HiveBatch *batch, HiveBatchFeatures *features)
+{
+	for (int s = 0; s < 2; s++) {
+		size_t queen = HIVE_PIECE_COUNT;
+		hive_lanes inventory = { 0 };
+
+		for (size_t p = 0; p < HIVE_PIECE_COUNT; p++) {
+			if (batch->sides[p] != s)
+				continue;
+			if (batch->types[p] == HIVE_QUEEN)
+				queen = p;
+			inventory -= hive_batch_row(batch->heights[p]) == 0;
+		}
+		memcpy(features->inventory[s], &inventory, sizeof(inventory));
+		if (queen == HIVE_PIECE_COUNT) {
+			memset(features->queenNeighbors[s], 0,
+					sizeof(features->queenNeighbors[s]));
+			memset(features->coveredBy[s], -1,
+					sizeof(features->coveredBy[s]));
+			continue;
+		}
+
+		const hive_lanes queenQ = hive_batch_row(batch->q[queen]);
+		const hive_lanes queenR = hive_batch_row(batch->r[queen]);
+		const hive_lanes placed =
+			hive_batch_row(batch->heights[queen]) != 0;
+		hive_lanes neighbors = { 0 };
+		/* the highest piece on the queen so far, the queen is at 1 */
+		hive_lanes topHeight = placed & 1;
+		hive_lanes coveredBy = ~(hive_lanes) { 0 };
+
+		for (size_t p = 0; p < HIVE_PIECE_COUNT; p++) {
+			if (p == queen)
+				continue;
+			const hive_lanes height =
+				hive_batch_row(batch->heights[p]);
+			const hive_lanes dq =
+				hive_batch_row(batch->q[p]) - queenQ;
+			const hive_lanes dr =
+				hive_batch_row(batch->r[p]) - queenR;
+			const hive_lanes ds = dq + dr;
+			const hive_lanes same = (dq == 0) & (dr == 0);
+			/* every occupied cell has one piece on the ground */
+			const hive_lanes adjacent = (dq >= -1) & (dq <= 1) &
+				(dr >= -1) & (dr <= 1) & (ds >= -1) & (ds <= 1) &
+				~same & (height == 1);
+			const hive_lanes above = same & (height > topHeight);
+
+			neighbors -= adjacent;
+			topHeight = (above & height) | (~above & topHeight);
+			coveredBy = (above & (int8_t) batch->sides[p]) |
+				(~above & coveredBy);
+		}
+		neighbors &= placed;
+		coveredBy = (placed & coveredBy) | ~placed;
+		memcpy(features->queenNeighbors[s], &neighbors,
+				sizeof(neighbors));
+		memcpy(features->coveredBy[s], &coveredBy, sizeof(coveredBy));
+	}
+}
+
+void hive_evaluate_batch(const Hive *const *hives, size_t count,
+		HiveBatchFeatures *features)
+{
+	HiveBatch batch;
+
+	for (size_t i = 0; i < count; i += HIVE_BATCH_SIZE) {
+		hive_batch_load(&batch, &hives[i], count - i);
+		hive_batch_features(&batch, &features[i / HIVE_BATCH_SIZE]);
+	}
+}
@@ -0,0 +1,233 @@
+#include "hex.h"
+
+/* the six neighbors of bit b are: b - 1 (north), b + 1 (south),
+ * b - 32 (north east), b + 31 (north west), b - 31 (south east) and
+ * b + 32 (south west)
+ */
+void hive_bitboard_neighbors(const HiveBitboard *b, HiveBitboard *out)
+{
+	const uint64_t *const w = b->words;
+
+	for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++) {
+		const uint64_t prev = i == 0 ? 0 : w[i - 1];
+		const uint64_t next = i == HIVE_BITBOARD_WORDS - 1 ? 0 : w[i + 1];
+		out->words[i] =
+			(w[i] << 1) | (prev >> 63) |
+			(w[i] >> 1) | (next << 63) |
+			(w[i] << 32) | (prev >> 32) |
+			(w[i] >> 32) | (next << 32) |
+			(w[i] << 31) | (prev >> 33) |
+			(w[i] >> 31) | (next << 33);
+	}
+}
+
+void hive_bitboard_flood(const HiveBitboard *seed, const HiveBitboard *within,
+		HiveBitboard *out)
+{
+	HiveBitboard grown;
+	bool changed;
+
+	*out = *seed;
+	do {
+		hive_bitboard_neighbors(out, &grown);
+		changed = false;
+		for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++) {
+			const uint64_t w = out->words[i] |
+				(grown.words[i] & within->words[i]);
+			changed |= w != out->words[i];
+			out->words[i] = w;
+		}
+	} while (changed);
+}
+
+bool hive_bitboard_isequal(const HiveBitboard *a, const HiveBitboard *b)
+{
+	return memcmp(a->words, b->words, sizeof(a->words)) == 0;
+}
+
+size_t hive_bitboard_count(const HiveBitboard *b)
+{
+	size_t cnt = 0;
+
+	for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++)
+		cnt += __builtin_popcountll(b->words[i]);
+	return cnt;
+}
+
+const int hive_bitoffsets[6] = {
+	[HIVE_NORTH] = -1,
+	[HIVE_SOUTH] = 1,
+	[HIVE_NORTH_EAST] = -HIVE_BITBOARD_SIZE,
+	[HIVE_NORTH_WEST] = HIVE_BITBOARD_SIZE - 1,
+	[HIVE_SOUTH_EAST] = -HIVE_BITBOARD_SIZE + 1,
+	[HIVE_SOUTH_WEST] = HIVE_BITBOARD_SIZE,
+};
+
+bool hive_masks_bitof(const HiveMasks *masks, Point at, size_t *bit)
+{
+	const int q = at.x - masks->origin.x;
+	const int r = at.y - (at.x >> 1) - masks->origin.y;
+	if (q < 0 || q >= HIVE_BITBOARD_SIZE ||
+			r < 0 || r >= HIVE_BITBOARD_SIZE)
+		return false;
+	*bit = q * HIVE_BITBOARD_SIZE + r;
+	return true;
+}
+
+Point hive_masks_pointof(const HiveMasks *masks, size_t bit)
+{
+	Point p;
+
+	p.x = bit / HIVE_BITBOARD_SIZE + masks->origin.x;
+	p.y = bit % HIVE_BITBOARD_SIZE + masks->origin.y + (p.x >> 1);
+	return p;
+}
+
+static void hive_masks_setcell(HiveMasks *masks, size_t bit,
+		const HiveCell *cell)
+{
+	const uint64_t m = (uint64_t) 1 << (bit % 64);
+	const size_t w = bit / 64;
+	const uint32_t count = cell == NULL ? 0 : cell->count;
+
+	for (uint32_t h = 0; h < HIVE_BITBOARD_HEIGHTS; h++)
+		if (count > h)
+			masks->heights[h].words[w] |= m;
+		else
+			masks->heights[h].words[w] &= ~m;
+	masks->sides[HIVE_BLACK].words[w] &= ~m;
+	masks->sides[HIVE_WHITE].words[w] &= ~m;
+	if (count > 0)
+		masks->sides[cell->stack[count - 1]->side].words[w] |= m;
+}
+
+/* recenters the window on the bounding box of all cells */
+void hive_masks_rebuild(HiveMasks *masks, const HiveCell *cells)
+{
+	Point min, max;
+	size_t bit;
+	bool any;
+
+	memset(masks, 0, sizeof(*masks));
+	any = false;
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &cells[i];
+		if (cell->count == 0)
+			continue;
+		const Point a = {
+			cell->position.x,
+			cell->position.y - (cell->position.x >> 1)
+		};
+		if (!any) {
+			min = a;
+			max = a;
+			any = true;
+			continue;
+		}
+		min.x = MIN(min.x, a.x);
+		min.y = MIN(min.y, a.y);
+		max.x = MAX(max.x, a.x);
+		max.y = MAX(max.y, a.y);
+	}
+	if (!any) {
+		masks->valid = true;
+		return;
+	}
+	/* keep two free cells on each side: one for the neighbors of the
+	 * outermost pieces and one so that shifting never wraps around
+	 * into the next column
+	 */
+	if (max.x - min.x >= HIVE_BITBOARD_SIZE - 4 ||
+			max.y - min.y >= HIVE_BITBOARD_SIZE - 4)
+		return;
+	masks->origin.x = min.x - (HIVE_BITBOARD_SIZE - (max.x - min.x)) / 2;
+	masks->origin.y = min.y - (HIVE_BITBOARD_SIZE - (max.y - min.y)) / 2;
+	masks->valid = true;
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &cells[i];
+		if (cell->count == 0)
+			continue;
+		if (hive_masks_bitof(masks, cell->position, &bit))
+			hive_masks_setcell(masks, bit, cell);
+	}
+}
+
+void hive_masks_update(HiveMasks *masks, const HiveCell *cells,
+		const HiveCell *cell, Point at)
+{
+	size_t bit;
+
+	if (masks->valid && hive_masks_bitof(masks, at, &bit)) {
+		const size_t q = bit / HIVE_BITBOARD_SIZE;
+		const size_t r = bit % HIVE_BITBOARD_SIZE;
+		if (cell == NULL || (q >= 2 && q < HIVE_BITBOARD_SIZE - 2 &&
+				r >= 2 && r < HIVE_BITBOARD_SIZE - 2)) {
+			hive_masks_setcell(masks, bit, cell);
+			return;
+		}
+	} else if (masks->valid && cell == NULL) {
+		/* an empty cell outside of the window is nothing new */
+		return;
+	}
+	hive_masks_rebuild(masks, cells);
+}
+
+void hive_masks_placements(const HiveMasks *masks, enum hive_side side,
+		HiveBitboard *out)
+{
+	HiveBitboard own, other;
+
+	hive_bitboard_neighbors(&masks->sides[side], &own);
+	hive_bitboard_neighbors(&masks->sides[!side], &other);
+	for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++)
+		out->words[i] = own.words[i] & ~other.words[i] &
+			~masks->heights[0].words[i];
+}
+
+bool hive_masks_isconnectedwithout(const HiveMasks *masks, Point at)
+{
+	HiveBitboard rest, seed, reached;
+	size_t bit;
+
+	rest = masks->heights[0];
+	if (hive_masks_bitof(masks, at, &bit) &&
+			!(masks->heights[1].words[bit / 64] &
+				((uint64_t) 1 << (bit % 64))))
+		rest.words[bit / 64] &= ~((uint64_t) 1 << (bit % 64));
+	memset(&seed, 0, sizeof(seed));
+	for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++)
+		if (rest.words[i] != 0) {
+			seed.words[i] = rest.words[i] & -rest.words[i];
+			break;
+		}
+	hive_bitboard_flood(&seed, &rest, &reached);
+	return hive_bitboard_isequal(&reached, &rest);
+}
+
+bool hive_masks_neighbors(const HiveMasks *masks, Point at, uint32_t *mask)
+{
+	size_t bit;
+
+	if (!masks->valid || !hive_masks_bitof(masks, at, &bit))
+		return false;
+	const size_t q = bit / HIVE_BITBOARD_SIZE;
+	const size_t r = bit % HIVE_BITBOARD_SIZE;
+	if (q == 0 || q == HIVE_BITBOARD_SIZE - 1 ||
+			r == 0 || r == HIVE_BITBOARD_SIZE - 1)
+		return false;
+	*mask = 0;
+	for (int d = 0; d < 6; d++)
+		*mask |= hive_bitboard_isset(&masks->heights[0],
+				bit + hive_bitoffsets[d]) << d;
+	return true;
+}
+
+void hive_masks_topoints(const HiveMasks *masks, const HiveBitboard *b,
+		PointList *list)
+{
+	for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++)
+		for (uint64_t w = b->words[i]; w != 0; w &= w - 1) {
+			const size_t bit = i * 64 + __builtin_ctzll(w);
+			point_list_push(list, hive_masks_pointof(masks, bit));
+		}
+}
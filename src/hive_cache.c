@@ -0,0 +1,136 @@
+#include "hex.h"
+
+void hive_cache_clear(Hive *hive)
+{
+	HiveMoveCache *const cache = &hive->cache;
+
+	for (size_t i = 0; i < HIVE_PIECE_COUNT; i++)
+		cache->entries[i].valid = false;
+}
+
+static void hive_cache_change(HiveMoveCache *cache, Point at, bool occupancy)
+{
+	struct hive_cache_change *const change =
+		&cache->changes[cache->numChanges % HIVE_CACHE_CHANGES];
+
+	change->index = cache->numChanges++;
+	change->serial = ++cache->numSerials;
+	change->at = at;
+	change->occupancy = occupancy;
+}
+
+/* 0 for the position the cache was cleared in */
+static uint64_t hive_cache_epochat(const HiveMoveCache *cache, uint64_t stamp)
+{
+	return stamp == 0 ? 0 :
+		cache->changes[(stamp - 1) % HIVE_CACHE_CHANGES].serial;
+}
+
+void hive_cache_update(Hive *hive, Point from, bool fromBoard,
+		Point to, bool toBoard)
+{
+	const HiveRegion *const board = &hive->board;
+
+	if (fromBoard)
+		hive_cache_change(&hive->cache, from,
+				hive_region_cellat(board, from) == NULL);
+	if (toBoard)
+		hive_cache_change(&hive->cache, to,
+				hive_region_countat(board, to) == 1);
+}
+
+/* checks if a change can change the moves of a piece of the given type
+ * at the given position, the ant and the spider stay on the ground and only
+ * see cells that became empty or occupied
+ */
+static bool hive_cache_reaches(enum hive_type type, Point at,
+		const struct hive_cache_change *change)
+{
+	const int dq = change->at.x - at.x;
+	const int dr = (change->at.y - (change->at.x >> 1)) -
+		(at.y - (at.x >> 1));
+	const int distance = MAX(MAX(abs(dq), abs(dr)), abs(dq + dr));
+
+	switch (type) {
+	case HIVE_ANT:
+		/* an ant can go around the whole hive */
+		return change->occupancy;
+	case HIVE_SPIDER:
+		/* three steps and the gates around the last one */
+		return change->occupancy && distance <= 4;
+	case HIVE_LADYBUG:
+		return distance <= 4;
+	default:
+		return true;
+	}
+}
+
+/* tests/hive.c puts pieces of its own onto the board, those have no
+ * entry
+ */
+static HiveCacheEntry *hive_cache_entryof(HiveMoveCache *cache,
+		const Hive *hive, const HivePiece *piece)
+{
+	const size_t index = ((uintptr_t) piece -
+			(uintptr_t) hive->allPieces) / sizeof(*piece);
+
+	return index < HIVE_PIECE_COUNT ? &cache->entries[index] : NULL;
+}
+
+HiveCacheEntry *hive_cache_lookup(HiveMoveCache *cache, const Hive *hive,
+		const HivePiece *piece)
+{
+	HiveCacheEntry *const entry = hive_cache_entryof(cache, hive, piece);
+
+	/* the change before the stamp must still be in the ring as well,
+	 * entries from undone moves have a stamp past the number of changes
+	 * or another epoch
+	 */
+	if (entry == NULL || !entry->valid ||
+			!point_isequal(entry->position, piece->position) ||
+			cache->numChanges - entry->stamp >=
+				HIVE_CACHE_CHANGES ||
+			entry->epoch != hive_cache_epochat(cache,
+				entry->stamp)) {
+		cache->misses++;
+		return NULL;
+	}
+	for (uint64_t c = entry->stamp; c < cache->numChanges; c++) {
+		const struct hive_cache_change *const change =
+			&cache->changes[c % HIVE_CACHE_CHANGES];
+		if (change->index != c || hive_cache_reaches(piece->type,
+					piece->position, change)) {
+			cache->misses++;
+			return NULL;
+		}
+	}
+	cache->hits++;
+	return entry;
+}
+
+void hive_cache_store(HiveMoveCache *cache, const Hive *hive,
+		const HivePiece *piece, const HiveMove *moves, size_t count)
+{
+	HiveCacheEntry *const entry = hive_cache_entryof(cache, hive, piece);
+
+	if (entry == NULL)
+		return;
+	entry->valid = count <= HIVE_CACHE_MOVES;
+	if (!entry->valid)
+		return;
+	entry->count = count;
+	entry->position = piece->position;
+	entry->stamp = cache->numChanges;
+	entry->epoch = hive_cache_epochat(cache, entry->stamp);
+	for (size_t i = 0; i < count; i++)
+		entry->to[i] = moves[i].to;
+}
+
+double hive_cache_hitrate(const HiveMoveCache *cache)
+{
+	const uint64_t lookups = cache->hits + cache->misses;
+
+	if (lookups == 0)
+		return 0;
+	return 100.0 * cache->hits / lookups;
+}
@@ -0,0 +1,402 @@
+#include "hex.h"
+
+/* what an occupied cell next to a queen, a piece that can't move without
+ * breaking the hive, a piece on top of the other queen and a piece left
+ * in the inventory are worth
+ */
+#define HIVE_EVAL_QUEEN 30
+#define HIVE_EVAL_PINNED 2
+#define HIVE_EVAL_COVER 40
+#define HIVE_EVAL_INVENTORY 2
+
+/* what a cell a piece that is not pinned can slide into is worth, an ant
+ * gets far from each of them, a spider only three steps
+ */
+static const int hive_eval_mobility[HIVE_PILLBUG_CARRYING] = {
+	[HIVE_ANT] = 4,
+	[HIVE_BEETLE] = 3,
+	[HIVE_GRASSHOPPER] = 2,
+	[HIVE_LADYBUG] = 2,
+	[HIVE_MOSQUITO] = 3,
+	[HIVE_PILLBUG] = 2,
+	[HIVE_QUEEN] = 2,
+	[HIVE_SPIDER] = 1,
+};
+
+static bool hive_eval_isadjacent(Point a, Point b)
+{
+	for (int d = 0; d < 6; d++) {
+		Point p;
+
+		p = b;
+		hive_movepoint(&p, d);
+		if (point_isequal(p, a))
+			return true;
+	}
+	return false;
+}
+
+/* bit d is set if the neighbor in direction d is occupied, for when the
+ * masks are not valid
+ */
+static uint32_t hive_eval_neighbors(const HiveRegion *board, Point at)
+{
+	uint32_t mask = 0;
+	Point p;
+
+	for (int d = 0; d < 6; d++) {
+		p = at;
+		hive_movepoint(&p, d);
+		if (hive_region_cellat(board, p) != NULL)
+			mask |= 1 << d;
+	}
+	return mask;
+}
+
+/* the axial steps of the directions, the same as hive_bitoffsets */
+static const int hive_eval_dq[6] = {
+	[HIVE_NORTH] = 0, [HIVE_SOUTH] = 0,
+	[HIVE_NORTH_EAST] = -1, [HIVE_NORTH_WEST] = 1,
+	[HIVE_SOUTH_EAST] = -1, [HIVE_SOUTH_WEST] = 1,
+};
+static const int hive_eval_dr[6] = {
+	[HIVE_NORTH] = -1, [HIVE_SOUTH] = 1,
+	[HIVE_NORTH_EAST] = 0, [HIVE_NORTH_WEST] = -1,
+	[HIVE_SOUTH_EAST] = 1, [HIVE_SOUTH_WEST] = 0,
+};
+
+#define hive_eval_patchbit(dq, dr) (((dq) + 2) * 5 + (dr) + 2)
+
+/* the cells up to two steps around a bit, bit hive_eval_patchbit(dq, dr)
+ * is the cell at (q + dq, r + dr); every occupied bit is two cells away
+ * from the border of the window and a word holds two columns
+ */
+static uint32_t hive_eval_patch(const HiveBitboard *occupied, size_t bit)
+{
+	const size_t q = bit / HIVE_BITBOARD_SIZE;
+	const size_t r = bit % HIVE_BITBOARD_SIZE;
+	uint32_t patch = 0;
+
+	for (size_t i = 0; i < 5; i++) {
+		const size_t c = q - 2 + i;
+		patch |= ((occupied->words[c / 2] >>
+				((c % 2) * HIVE_BITBOARD_SIZE + r - 2)) &
+			0x1f) << (i * 5);
+	}
+	return patch;
+}
+
+/* the empty neighbors a piece slides into by the slide table, indexed by
+ * the occupied neighbors of the cell and the neighbors with an occupied
+ * cell right behind them (one of the three cells next to the neighbor
+ * that are not next to the piece)
+ */
+static uint8_t hive_eval_slidetable[64][64];
+/* the cells behind each neighbor as bits of a patch */
+static uint32_t hive_eval_behind[6];
+
+/* the direction of the cell at the given steps from a cell */
+static int hive_eval_direction(int dq, int dr)
+{
+	for (int d = 0; d < 6; d++)
+		if (hive_eval_dq[d] == dq && hive_eval_dr[d] == dr)
+			return d;
+	return -1;
+}
+
+__attribute__((constructor)) static void hive_eval_inittables(void)
+{
+	for (int d = 0; d < 6; d++)
+		for (int e = 0; e < 6; e++) {
+			const int dq = hive_eval_dq[d] + hive_eval_dq[e];
+			const int dr = hive_eval_dr[d] + hive_eval_dr[e];
+			/* the cell itself or a gate */
+			if (MAX(MAX(abs(dq), abs(dr)), abs(dq + dr)) < 2)
+				continue;
+			hive_eval_behind[d] |= 1 << hive_eval_patchbit(dq, dr);
+		}
+	for (uint32_t around = 0; around < 64; around++)
+		for (uint32_t behind = 0; behind < 64; behind++)
+			for (int d = 0; d < 6; d++) {
+				uint32_t mask;
+
+				if (around & (1 << d))
+					continue;
+				mask = 1 << hive_oppositedirection(d);
+				for (int g = 0; g < 2; g++) {
+					const int gate = hive_gates[d][g];
+					const int e = hive_eval_direction(
+						hive_eval_dq[d] +
+						hive_eval_dq[gate],
+						hive_eval_dr[d] +
+						hive_eval_dr[gate]);
+					if (around & (1 << e))
+						mask |= 1 << gate;
+				}
+				/* any one of the cells behind will do */
+				if (behind & (1 << d))
+					mask |= 1 << d;
+				if (hive_slides[d][mask] & HIVE_SLIDE_FREE)
+					hive_eval_slidetable[around][behind]++;
+			}
+}
+
+/* the empty neighbors a piece on the given bit slides into */
+static uint8_t hive_eval_slidesbit(const HiveBitboard *occupied, size_t bit)
+{
+	const uint32_t patch = hive_eval_patch(occupied, bit);
+	uint32_t around = 0, behind = 0;
+
+	for (int d = 0; d < 6; d++) {
+		around |= ((patch >> hive_eval_patchbit(hive_eval_dq[d],
+					hive_eval_dr[d])) & 1) << d;
+		behind |= (uint32_t) ((patch & hive_eval_behind[d]) != 0) << d;
+	}
+	return hive_eval_slidetable[around][behind];
+}
+
+static uint8_t hive_eval_slides(const HiveRegion *board, Point at)
+{
+	uint8_t count = 0;
+	size_t bit;
+	Point p;
+
+	if (board->masks.valid && hive_masks_bitof(&board->masks, at, &bit))
+		return hive_eval_slidesbit(&board->masks.heights[0], bit);
+	for (int d = 0; d < 6; d++) {
+		p = at;
+		hive_movepoint(&p, d);
+		if (hive_region_cellat(board, p) == NULL &&
+				(hive_slides[d][hive_eval_neighbors(board, p)] &
+				 HIVE_SLIDE_FREE))
+			count++;
+	}
+	return count;
+}
+
+/* hex distance with the axial coordinates */
+static int hive_eval_distance(Point a, Point b)
+{
+	const int dq = a.x - b.x;
+	const int dr = (a.y - (a.x >> 1)) - (b.y - (b.x >> 1));
+	return MAX(MAX(abs(dq), abs(dr)), abs(dq + dr));
+}
+
+/* cells that became empty or occupied change the cells a piece can slide
+ * into up to two cells away
+ */
+static void hive_eval_around(const HiveRegion *board, HiveEvalState *eval,
+		const Point *changed, size_t numChanged)
+{
+	for (uint64_t v = board->graph.vertices; v != 0; v &= v - 1) {
+		const uint32_t vertex = __builtin_ctzll(v);
+		const Point at = eval->positions[vertex];
+
+		for (size_t c = 0; c < numChanged; c++)
+			if (hive_eval_distance(at, changed[c]) <= 2) {
+				eval->mobility[vertex] =
+					hive_eval_slides(board, at);
+				break;
+			}
+	}
+}
+
+static void hive_eval_cover(const HiveRegion *board, HiveEvalState *eval)
+{
+	for (int s = 0; s < 2; s++) {
+		const HiveCell *cell;
+
+		eval->coveredBy[s] = -1;
+		if (!eval->hasQueen[s])
+			continue;
+		/* the queen can't climb, so anything above it covers it */
+		cell = hive_region_cellat(board, eval->queens[s]);
+		if (cell != NULL && cell->count > 1)
+			eval->coveredBy[s] = cell->stack[cell->count - 1]->side;
+	}
+}
+
+void hive_eval_compute(const Hive *hive, HiveEvalState *eval)
+{
+	const HiveRegion *const board = &hive->board;
+	HivePiece *pieces[6];
+
+	memset(eval, 0, sizeof(*eval));
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &board->cells[i];
+		if (cell->count == 0)
+			continue;
+		const HivePiece *const top = cell->stack[cell->count - 1];
+		eval->tops[top->side][top->type] |=
+			(uint64_t) 1 << cell->vertex;
+		eval->mobility[cell->vertex] =
+			hive_eval_slides(board, cell->position);
+		eval->positions[cell->vertex] = cell->position;
+		for (uint32_t l = 0; l < cell->count; l++) {
+			const HivePiece *const piece = cell->stack[l];
+			eval->placed[piece->side]++;
+			if (piece->type != HIVE_QUEEN)
+				continue;
+			eval->hasQueen[piece->side] = true;
+			eval->queens[piece->side] = cell->position;
+			eval->queenNeighbors[piece->side] =
+				hive_region_getsurrounding(board,
+						cell->position, pieces);
+		}
+	}
+	for (int s = 0; s < 2; s++) {
+		const HiveRegion *const inventory = s == HIVE_WHITE ?
+			&hive->whiteInventory : &hive->blackInventory;
+
+		for (size_t i = 0; i < inventory->numPieces; i++)
+			eval->inventory[s][inventory->pieces[i]->type]++;
+	}
+	hive_eval_cover(board, eval);
+}
+
+void hive_eval_toggle(Hive *hive, Point at)
+{
+	const HiveCell *const cell = hive_region_cellat(&hive->board, at);
+	const HivePiece *top;
+
+	if (cell == NULL)
+		return;
+	top = cell->stack[cell->count - 1];
+	hive->eval.tops[top->side][top->type] ^= (uint64_t) 1 << cell->vertex;
+}
+
+/* a cell became empty or occupied, the queen that moved is counted
+ * again instead
+ */
+static void hive_eval_occupy(HiveEvalState *eval, const HivePiece *piece,
+		Point at, int delta)
+{
+	for (int s = 0; s < 2; s++) {
+		if (!eval->hasQueen[s] || (piece->type == HIVE_QUEEN &&
+					piece->side == (enum hive_side) s))
+			continue;
+		if (hive_eval_isadjacent(eval->queens[s], at))
+			eval->queenNeighbors[s] += delta;
+	}
+}
+
+void hive_eval_update(Hive *hive, const HivePiece *piece,
+		Point from, bool fromBoard, Point to, bool toBoard,
+		const uint8_t *mobility)
+{
+	const HiveRegion *const board = &hive->board;
+	HiveEvalState *const eval = &hive->eval;
+	Point changed[2];
+	size_t numChanged = 0;
+	HivePiece *pieces[6];
+
+	if (fromBoard != toBoard) {
+		const int delta = toBoard ? 1 : -1;
+
+		eval->placed[piece->side] += delta;
+		eval->inventory[piece->side][piece->type] -= delta;
+	}
+	if (fromBoard) {
+		hive_eval_toggle(hive, from);
+		if (hive_region_cellat(board, from) == NULL) {
+			hive_eval_occupy(eval, piece, from, -1);
+			changed[numChanged++] = from;
+		}
+	}
+	if (toBoard) {
+		hive_eval_toggle(hive, to);
+		if (hive_region_countat(board, to) == 1) {
+			hive_eval_occupy(eval, piece, to, 1);
+			eval->positions[hive_region_vertexat(board, to)] = to;
+			changed[numChanged++] = to;
+		}
+	}
+	if (mobility != NULL)
+		memcpy(eval->mobility, mobility, sizeof(eval->mobility));
+	else if (numChanged > 0)
+		hive_eval_around(board, eval, changed, numChanged);
+	if (piece->type == HIVE_QUEEN) {
+		eval->hasQueen[piece->side] = toBoard;
+		eval->queens[piece->side] = to;
+		eval->queenNeighbors[piece->side] = !toBoard ? 0 :
+			hive_region_getsurrounding(board, to, pieces);
+	}
+	hive_eval_cover(board, eval);
+}
+
+static int hive_eval_score(const Hive *hive, const HiveEvalState *eval)
+{
+	const uint64_t pinned = hive_graph_pinned(&hive->board.graph);
+	int score[2] = { 0, 0 };
+
+	for (int s = 0; s < 2; s++) {
+		uint64_t all = 0;
+		int left = 0;
+
+		for (int t = 0; t < HIVE_PILLBUG_CARRYING; t++) {
+			all |= eval->tops[s][t];
+			left += eval->inventory[s][t];
+			/* no piece moves before its queen is placed */
+			if (!eval->hasQueen[s])
+				continue;
+			for (uint64_t v = eval->tops[s][t] & ~pinned; v != 0;
+					v &= v - 1)
+				score[s] += hive_eval_mobility[t] *
+					eval->mobility[__builtin_ctzll(v)];
+		}
+		score[s] -= HIVE_EVAL_PINNED * __builtin_popcountll(all & pinned);
+		score[s] -= HIVE_EVAL_QUEEN * eval->queenNeighbors[s];
+		score[s] += HIVE_EVAL_INVENTORY * left;
+		if (eval->coveredBy[s] >= 0 && eval->coveredBy[s] != s)
+			score[eval->coveredBy[s]] += HIVE_EVAL_COVER;
+	}
+	return score[hive->turn] - score[!hive->turn];
+}
+
+#ifndef NDEBUG
+static bool hive_eval_isequal(const HiveEvalState *a, const HiveEvalState *b,
+		uint64_t vertices)
+{
+	for (uint64_t v = vertices; v != 0; v &= v - 1)
+		if (a->mobility[__builtin_ctzll(v)] !=
+				b->mobility[__builtin_ctzll(v)] ||
+				!point_isequal(a->positions[__builtin_ctzll(v)],
+					b->positions[__builtin_ctzll(v)]))
+			return false;
+	if (memcmp(a->tops, b->tops, sizeof(a->tops)) != 0 ||
+			memcmp(a->placed, b->placed, sizeof(a->placed)) != 0 ||
+			memcmp(a->inventory, b->inventory,
+				sizeof(a->inventory)) != 0)
+		return false;
+	for (int s = 0; s < 2; s++) {
+		if (a->hasQueen[s] != b->hasQueen[s] ||
+				a->queenNeighbors[s] != b->queenNeighbors[s] ||
+				a->coveredBy[s] != b->coveredBy[s])
+			return false;
+		if (a->hasQueen[s] && !point_isequal(a->queens[s],
+					b->queens[s]))
+			return false;
+	}
+	return true;
+}
+#endif
+
+int hive_evaluate(const Hive *hive)
+{
+#ifndef NDEBUG
+	HiveEvalState full;
+
+	hive_eval_compute(hive, &full);
+	assert(hive_eval_isequal(&full, &hive->eval,
+				hive->board.graph.vertices));
+#endif
+	return hive_eval_score(hive, &hive->eval);
+}
+
+int hive_evaluate_full(const Hive *hive)
+{
+	HiveEvalState eval;
+
+	hive_eval_compute(hive, &eval);
+	return hive_eval_score(hive, &eval);
+}
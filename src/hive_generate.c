@@ -0,0 +1,781 @@
+#include "hex.h"
+
+/* The generator never moves a piece on the board. Instead, the piece that
+ * is being moved is accounted for in the heights: it is lifted off the
+ * cell it started on and raised onto the cell it is currently at.
+ * Both are the same cell until the piece actually walks somewhere.
+ */
+struct hive_generator {
+	const Hive *hive;
+	/* NULL if the caller has none */
+	HiveMoveCache *cache;
+	const HiveRegion *board;
+	HiveMoveList *list;
+	/* first move that the current move is checked against to filter
+	 * out duplicates (for example from two mosquito copies)
+	 */
+	size_t first;
+	/* the destinations of the moves since first */
+	HiveBitboard visited;
+	bool wantMoves;
+	bool wantThrows;
+	bool hasMover;
+	Point lifted;
+	Point raised;
+	/* 0 if the perimeter was not built yet, -1 if it can't be */
+	int hasPerimeter;
+	struct hive_perimeter {
+		/* the empty cells next to the hive */
+		HiveBitboard cells;
+		/* per cell and direction if a piece can slide that way,
+		 * once without and once with the need for a pivot
+		 */
+		uint8_t slides[HIVE_BITBOARD_SIZE * HIVE_BITBOARD_SIZE];
+		uint8_t pivots[HIVE_BITBOARD_SIZE * HIVE_BITBOARD_SIZE];
+	} perimeter;
+};
+
+static size_t hive_gen_countat(const struct hive_generator *g, Point at)
+{
+	size_t cnt;
+
+	cnt = hive_region_countat(g->board, at);
+	if (g->hasMover) {
+		cnt -= point_isequal(at, g->lifted);
+		cnt += point_isequal(at, g->raised);
+	}
+	return cnt;
+}
+
+/* hex distance with the axial coordinates */
+static int hive_gen_distance(Point a, Point b)
+{
+	const int dq = a.x - b.x;
+	const int dr = (a.y - (a.x >> 1)) - (b.y - (b.x >> 1));
+	return MAX(MAX(abs(dq), abs(dr)), abs(dq + dr));
+}
+
+/* the occupied neighbors of a cell, bit d is set if the neighbor in
+ * direction d is occupied
+ */
+static uint32_t hive_gen_neighbors(const struct hive_generator *g, Point at)
+{
+	uint32_t mask;
+	Point p;
+
+	if (!hive_masks_neighbors(&g->board->masks, at, &mask)) {
+		mask = 0;
+		for (int d = 0; d < 6; d++) {
+			p = at;
+			hive_movepoint(&p, d);
+			if (hive_gen_countat(g, p) > 0)
+				mask |= 1 << d;
+		}
+		return mask;
+	}
+	/* the masks know nothing about the piece being moved */
+	if (!g->hasMover || point_isequal(g->lifted, g->raised) ||
+			(hive_gen_distance(at, g->lifted) != 1 &&
+			 hive_gen_distance(at, g->raised) != 1))
+		return mask;
+	for (int d = 0; d < 6; d++) {
+		p = at;
+		hive_movepoint(&p, d);
+		if (point_isequal(p, g->raised))
+			mask |= 1 << d;
+		else if (point_isequal(p, g->lifted) &&
+				hive_gen_countat(g, p) == 0)
+			mask &= ~(1 << d);
+	}
+	return mask;
+}
+
+/* moves are only checked for duplicates against the moves after this */
+static void hive_gen_window(struct hive_generator *g)
+{
+	g->first = g->list->count;
+	memset(&g->visited, 0, sizeof(g->visited));
+}
+
+static void hive_gen_push(struct hive_generator *g, bool fromInventory,
+		Point from, Point to, bool isThrow)
+{
+	HiveMove move;
+	size_t bit;
+	bool isNew = false;
+
+	/* all moves since first come from the same cell unless they are
+	 * throws, so only a destination seen before needs a closer look
+	 */
+	if (hive_masks_bitof(&g->board->masks, to, &bit)) {
+		isNew = !hive_bitboard_isset(&g->visited, bit);
+		g->visited.words[bit / 64] |= (uint64_t) 1 << (bit % 64);
+	}
+	for (size_t i = g->first; !isNew && i < g->list->count; i++) {
+		const HiveMove *const m = &g->list->moves[i];
+		if (m->isThrow == isThrow && point_isequal(m->from, from) &&
+				point_isequal(m->to, to))
+			return;
+	}
+	move.fromInventory = fromInventory;
+	move.isThrow = isThrow;
+	move.from = from;
+	move.to = to;
+	hive_move_list_push(g->list, &move);
+}
+
+/* note: pos is the position that is already moved towards dir */
+static bool hive_gen_canslide(const struct hive_generator *g, Point pos,
+		int dir, bool needsPivot)
+{
+	/* make sure to not pass through pieces */
+	if (hive_gen_countat(g, pos) > 0)
+		return false;
+	return hive_slides[dir][hive_gen_neighbors(g, pos)] &
+		(needsPivot ? HIVE_SLIDE_PIVOT : HIVE_SLIDE_FREE);
+}
+
+/* note: pos is the position that is already moved towards dir */
+static bool hive_gen_canclimb(const struct hive_generator *g, Point pos,
+		int dir)
+{
+	Point prevPos;
+	size_t heights[4];
+	uint32_t mask;
+
+	prevPos = pos;
+	hive_movepoint(&prevPos, hive_oppositedirection(dir));
+	heights[0] = hive_gen_countat(g, prevPos);
+	mask = hive_gen_neighbors(g, pos);
+	/* check if moving there would isolate the piece */
+	if (__builtin_popcount(mask) == 1 && heights[0] == 1)
+		return false;
+	heights[1] = hive_gen_countat(g, pos);
+	for (int i = 0; i < 2; i++) {
+		Point p;
+
+		if (!(mask & (1 << hive_gates[dir][i]))) {
+			heights[2 + i] = 0;
+			continue;
+		}
+		p = pos;
+		hive_movepoint(&p, hive_gates[dir][i]);
+		heights[2 + i] = hive_gen_countat(g, p);
+	}
+	return hive_climbs[hive_climbheight(heights[0])]
+		[hive_climbheight(heights[1])]
+		[hive_climbheight(heights[2])]
+		[hive_climbheight(heights[3])];
+}
+
+/* Builds the graph of the empty cells around the hive where each edge is a
+ * slide that passes the gate and keeps contact to the hive. This does not
+ * know about any mover, so the slides next to the cell a piece starts from
+ * are still checked one by one.
+ */
+static bool hive_gen_buildperimeter(struct hive_generator *g)
+{
+	struct hive_perimeter *const per = &g->perimeter;
+	const HiveBitboard *const occupied = &g->board->masks.heights[0];
+
+	if (g->hasPerimeter != 0)
+		return g->hasPerimeter > 0;
+	g->hasPerimeter = -1;
+	if (!g->board->masks.valid)
+		return false;
+	hive_bitboard_neighbors(occupied, &per->cells);
+	for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++)
+		per->cells.words[i] &= ~occupied->words[i];
+	for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++)
+		for (uint64_t w = per->cells.words[i]; w != 0; w &= w - 1) {
+			const size_t a = i * 64 + __builtin_ctzll(w);
+			uint8_t slides = 0, pivots = 0;
+
+			for (int d = 0; d < 6; d++) {
+				const size_t b = a + hive_bitoffsets[d];
+				uint32_t mask;
+
+				/* the target must be empty and next to the hive */
+				if (!hive_bitboard_isset(&per->cells, b))
+					continue;
+				/* the piece itself is in the source cell */
+				mask = 1 << hive_oppositedirection(d);
+				for (int n = 0; n < 6; n++)
+					mask |= hive_bitboard_isset(occupied,
+						b + hive_bitoffsets[n]) << n;
+				if (hive_slides[d][mask] & HIVE_SLIDE_FREE)
+					slides |= 1 << d;
+				if (hive_slides[d][mask] & HIVE_SLIDE_PIVOT)
+					pivots |= 1 << d;
+			}
+			per->slides[a] = slides;
+			per->pivots[a] = pivots;
+		}
+	g->hasPerimeter = 1;
+	return true;
+}
+
+/* the moving piece is at `from` and slides to `to` which lies in the given
+ * direction
+ */
+static bool hive_gen_slide(struct hive_generator *g, Point from, Point to,
+		int dir, bool needsPivot)
+{
+	size_t bit;
+
+	/* only cells right next to where the piece started see it gone */
+	if (hive_gen_distance(to, g->lifted) > 1 &&
+			hive_gen_buildperimeter(g) &&
+			hive_masks_bitof(&g->board->masks, from, &bit) &&
+			hive_bitboard_isset(&g->perimeter.cells, bit))
+		return ((needsPivot ? g->perimeter.pivots[bit] :
+				g->perimeter.slides[bit]) >> dir) & 1;
+	g->raised = from;
+	return hive_gen_canslide(g, to, dir, needsPivot);
+}
+
+/* checks if the hive stays in one piece when the top piece at the given
+ * position is lifted
+ */
+static bool hive_gen_isconnectedwithout(const struct hive_generator *g,
+		Point at)
+{
+	int vertex;
+
+	/* a single piece is not a hive */
+	if (g->board->numPieces <= 1)
+		return false;
+	if ((vertex = hive_region_vertexat(g->board, at)) < 0)
+		return true;
+	return !(hive_graph_pinned(&g->board->graph) &
+			((uint64_t) 1 << vertex));
+}
+
+static bool hive_gen_canmoveaway(const struct hive_generator *g,
+		const HivePiece *piece)
+{
+	/* check if the queen was placed already */
+	if (!g->hive->eval.hasQueen[g->hive->turn])
+		return false;
+	if (hive_region_getbelow(g->board, piece) != NULL)
+		return true;
+	/* check if this would break the hive */
+	return hive_gen_isconnectedwithout(g, piece->position);
+}
+
+/* all cells reachable by sliding any number of steps */
+static void hive_gen_ant(struct hive_generator *g, const HivePiece *piece)
+{
+	/* the perimeter of a hive of n cells has at most 2n + 6 cells */
+	Point visited[2 * HIVE_PIECE_COUNT + 8];
+	size_t numVisited, cur;
+	Point pos;
+
+	visited[0] = piece->position;
+	numVisited = 1;
+	for (cur = 0; cur < numVisited; cur++) {
+		for (int d = 0; d < 6; d++) {
+			size_t v;
+
+			pos = visited[cur];
+			hive_movepoint(&pos, d);
+			for (v = 0; v < numVisited; v++)
+				if (point_isequal(visited[v], pos))
+					break;
+			if (v != numVisited)
+				continue;
+			if (!hive_gen_slide(g, visited[cur], pos, d, false))
+				continue;
+			visited[numVisited++] = pos;
+			hive_gen_push(g, false, piece->position, pos, false);
+		}
+	}
+}
+
+static void hive_gen_spiderwalk(struct hive_generator *g,
+		const HivePiece *piece, Point path[4], uint32_t step)
+{
+	Point pos;
+
+	for (int d = 0; d < 6; d++) {
+		uint32_t s;
+
+		pos = path[step];
+		hive_movepoint(&pos, d);
+		/* a path may not visit a cell twice */
+		for (s = 0; s < step; s++)
+			if (point_isequal(path[s], pos))
+				break;
+		if (s != step)
+			continue;
+		if (!hive_gen_slide(g, path[step], pos, d, true))
+			continue;
+		if (step == 2) {
+			hive_gen_push(g, false, piece->position, pos, false);
+			continue;
+		}
+		path[step + 1] = pos;
+		hive_gen_spiderwalk(g, piece, path, step + 1);
+	}
+}
+
+/* all cells that are exactly three steps away */
+static void hive_gen_spider(struct hive_generator *g, const HivePiece *piece)
+{
+	Point path[4];
+
+	path[0] = piece->position;
+	hive_gen_spiderwalk(g, piece, path, 0);
+}
+
+/* one step, the queen and the pillbug move like this */
+static void hive_gen_step(struct hive_generator *g, const HivePiece *piece)
+{
+	Point pos;
+
+	for (int d = 0; d < 6; d++) {
+		pos = piece->position;
+		hive_movepoint(&pos, d);
+		if (hive_gen_slide(g, piece->position, pos, d, false))
+			hive_gen_push(g, false, piece->position, pos, false);
+	}
+}
+
+static void hive_gen_beetle(struct hive_generator *g, const HivePiece *piece)
+{
+	Point pos;
+
+	for (int d = 0; d < 6; d++) {
+		pos = piece->position;
+		hive_movepoint(&pos, d);
+		if (hive_gen_canclimb(g, pos, d))
+			hive_gen_push(g, false, piece->position, pos, false);
+	}
+}
+
+static void hive_gen_grasshopper(struct hive_generator *g,
+		const HivePiece *piece)
+{
+	Point pos;
+	uint32_t cnt;
+
+	for (int d = 0; d < 6; d++) {
+		pos = piece->position;
+		cnt = 0;
+		do {
+			cnt++;
+			hive_movepoint(&pos, d);
+		} while (hive_gen_countat(g, pos) > 0);
+		if (cnt == 1)
+			continue;
+		hive_gen_push(g, false, piece->position, pos, false);
+	}
+}
+
+static void hive_gen_ladybugwalk(struct hive_generator *g,
+		const HivePiece *piece, Point cur, uint32_t numRemaining)
+{
+	Point pos;
+
+	for (int d = 0; d < 6; d++) {
+		pos = cur;
+		hive_movepoint(&pos, d);
+		if (point_isequal(piece->position, pos))
+			continue;
+		g->raised = cur;
+		const bool occupied = hive_gen_countat(g, pos) > 0;
+		/* move over two non null pieces and then drop down */
+		if (occupied != (numRemaining > 1))
+			continue;
+		if (!hive_gen_canclimb(g, pos, d))
+			continue;
+		if (numRemaining == 1)
+			hive_gen_push(g, false, piece->position, pos, false);
+		else
+			hive_gen_ladybugwalk(g, piece, pos, numRemaining - 1);
+	}
+}
+
+static void hive_gen_ladybug(struct hive_generator *g, const HivePiece *piece)
+{
+	hive_gen_ladybugwalk(g, piece, piece->position, 3);
+}
+
+/* the moves of the pillbug's special ability: the piece is carried on top
+ * of the actor and then dropped onto an empty cell next to the actor
+ */
+static void hive_gen_carry(struct hive_generator *g, const HivePiece *actor,
+		const HivePiece *piece)
+{
+	Point pos;
+
+	g->lifted = piece->position;
+	g->raised = actor->position;
+	for (int d = 0; d < 6; d++) {
+		pos = actor->position;
+		hive_movepoint(&pos, d);
+		if (point_isequal(pos, piece->position))
+			continue;
+		if (hive_gen_countat(g, pos) > 0)
+			continue;
+		if (!hive_gen_canclimb(g, pos, d))
+			continue;
+		hive_gen_push(g, false, piece->position, pos, true);
+	}
+	g->lifted = actor->position;
+	g->raised = actor->position;
+}
+
+static bool hive_gen_cancarry(struct hive_generator *g, const HivePiece *actor,
+		const HivePiece *piece, int dir)
+{
+	/* nothing moves before the queen is placed */
+	if (!g->hive->eval.hasQueen[g->hive->turn])
+		return false;
+	/* can't carry an immobile moved piece */
+	if (piece->flags & HIVE_IMMOBILE)
+		return false;
+	/* can only carry pieces not in a stack */
+	if (hive_region_getbelow(g->board, piece) != NULL)
+		return false;
+	g->lifted = piece->position;
+	g->raised = piece->position;
+	const bool canClimb = hive_gen_canclimb(g, actor->position,
+			hive_oppositedirection(dir));
+	g->lifted = actor->position;
+	g->raised = actor->position;
+	if (!canClimb)
+		return false;
+	/* the carried piece must not break the hive either */
+	return hive_gen_isconnectedwithout(g, piece->position);
+}
+
+static void hive_gen_throws(struct hive_generator *g, const HivePiece *actor)
+{
+	HivePiece *pieces[6];
+
+	hive_region_getsurroundingr(g->board, actor->position, pieces);
+	for (int d = 0; d < 6; d++) {
+		HivePiece *const piece = pieces[d];
+		if (piece == NULL || !hive_gen_cancarry(g, actor, piece, d))
+			continue;
+		hive_gen_carry(g, actor, piece);
+	}
+}
+
+static void hive_gen_type(struct hive_generator *g, const HivePiece *piece,
+		enum hive_type type, bool canMove);
+
+static void hive_gen_mosquito(struct hive_generator *g,
+		const HivePiece *piece)
+{
+	HivePiece *pieces[6];
+	uint32_t types;
+
+	if (hive_region_getbelow(g->board, piece) != NULL) {
+		if (g->wantMoves)
+			hive_gen_beetle(g, piece);
+		return;
+	}
+	hive_region_getsurroundingr(g->board, piece->position, pieces);
+	types = 0;
+	for (int d = 0; d < 6; d++) {
+		const HivePiece *const p = pieces[d];
+		if (p == NULL || p->type == HIVE_MOSQUITO ||
+				(types & (1 << p->type)))
+			continue;
+		types |= 1 << p->type;
+		hive_gen_type(g, piece, p->type, true);
+	}
+}
+
+static void hive_gen_type(struct hive_generator *g, const HivePiece *piece,
+		enum hive_type type, bool canMove)
+{
+	static void (*const generators[])(struct hive_generator *g,
+			const HivePiece *piece) = {
+		[HIVE_ANT] = hive_gen_ant,
+		[HIVE_BEETLE] = hive_gen_beetle,
+		[HIVE_GRASSHOPPER] = hive_gen_grasshopper,
+		[HIVE_LADYBUG] = hive_gen_ladybug,
+		[HIVE_PILLBUG] = hive_gen_step,
+		[HIVE_QUEEN] = hive_gen_step,
+		[HIVE_SPIDER] = hive_gen_spider,
+	};
+
+	g->hasMover = true;
+	g->lifted = piece->position;
+	g->raised = piece->position;
+	switch (type) {
+	case HIVE_MOSQUITO:
+		/* the mosquito needs to move itself to copy anything */
+		if (canMove)
+			hive_gen_mosquito(g, piece);
+		break;
+	case HIVE_PILLBUG:
+		/* the pillbug has the option to not move itself */
+		if (canMove && g->wantMoves)
+			hive_gen_step(g, piece);
+		if (g->wantThrows)
+			hive_gen_throws(g, piece);
+		break;
+	case HIVE_PILLBUG_CARRYING:
+		break;
+	default:
+		if (canMove && g->wantMoves)
+			generators[type](g, piece);
+	}
+}
+
+static bool hive_gen_ismovable(const struct hive_generator *g,
+		const HivePiece *piece)
+{
+	if (piece->side != g->hive->turn || (piece->flags & HIVE_IMMOBILE))
+		return false;
+	return hive_region_pieceatr(g->board, NULL, piece->position) == piece;
+}
+
+/* the moves of the piece itself, they are taken from the cache if there
+ * is one and nothing within reach of the piece changed since they were
+ * generated; a pinned piece can't move at all, so the pins need no
+ * checking
+ */
+static void hive_gen_own(struct hive_generator *g, const HivePiece *piece,
+		bool canMove)
+{
+	HiveMoveCache *const cache = g->cache;
+	const HiveCacheEntry *entry;
+	const size_t first = g->list->count;
+	HiveMove move;
+
+	/* the pieces that take a single step or jump are quicker to generate
+	 * than to look up, the mosquito depends on its neighbors
+	 */
+	if (cache == NULL || !canMove || (piece->type != HIVE_ANT &&
+				piece->type != HIVE_SPIDER &&
+				piece->type != HIVE_LADYBUG)) {
+		hive_gen_type(g, piece, piece->type, canMove);
+		return;
+	}
+	entry = hive_cache_lookup(cache, g->hive, piece);
+	if (entry != NULL && !cache->verify) {
+		move.fromInventory = false;
+		move.isThrow = false;
+		move.from = piece->position;
+		for (uint32_t i = 0; i < entry->count; i++) {
+			move.to = entry->to[i];
+			hive_move_list_push(g->list, &move);
+		}
+		return;
+	}
+	hive_gen_type(g, piece, piece->type, canMove);
+	/* a hit keeps its stamp, so that it lasts as long as without the
+	 * verify mode
+	 */
+	if (entry != NULL) {
+		bool isEqual = entry->count == g->list->count - first;
+
+		for (uint32_t i = 0; isEqual && i < entry->count; i++)
+			isEqual = point_isequal(entry->to[i],
+					g->list->moves[first + i].to);
+		cache->mismatches += !isEqual;
+		return;
+	}
+	hive_cache_store(cache, g->hive, piece, &g->list->moves[first],
+			g->list->count - first);
+}
+
+static void hive_gen_placements(struct hive_generator *g,
+		const HivePiece *piece)
+{
+	const Hive *const hive = g->hive;
+	const HiveRegion *const board = g->board;
+	HiveBitboard places;
+	HivePiece *pieces[6];
+	Point pos;
+
+	/* the queen has to be placed as the fourth piece at the latest */
+	if (piece->type != HIVE_QUEEN && !hive->eval.hasQueen[hive->turn] &&
+			hive->eval.placed[hive->turn] == 3)
+		return;
+
+	if (board->numPieces == 0) {
+		/* any cell works, the hive has no origin */
+		hive_gen_push(g, true, piece->position, (Point) { 0, 0 },
+				false);
+		return;
+	}
+
+	if (board->numPieces > 1 && board->masks.valid) {
+		hive_masks_placements(&board->masks, hive->turn, &places);
+		for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++)
+			for (uint64_t w = places.words[i]; w != 0; w &= w - 1) {
+				const size_t bit = i * 64 + __builtin_ctzll(w);
+				hive_gen_push(g, true, piece->position,
+					hive_masks_pointof(&board->masks, bit),
+					false);
+			}
+		return;
+	}
+
+	for (size_t i = 0; i < board->numPieces; i++) {
+		const HivePiece *const p = board->pieces[i];
+		if (p->side != hive->turn && board->numPieces > 1)
+			continue;
+		for (int d = 0; d < 6; d++) {
+			bool affirm;
+
+			pos = p->position;
+			hive_movepoint(&pos, d);
+			if (hive_region_countat(board, pos) > 0)
+				continue;
+			if (hive_region_getsurroundingr(board, pos, pieces) == 1 &&
+					board->numPieces == 1) {
+				hive_gen_push(g, true, piece->position, pos,
+						false);
+				continue;
+			}
+			affirm = false;
+			for (int n = 0; n < 6; n++) {
+				if (pieces[n] == NULL)
+					continue;
+				if (pieces[n]->side != hive->turn) {
+					affirm = false;
+					break;
+				}
+				affirm = true;
+			}
+			if (affirm)
+				hive_gen_push(g, true, piece->position, pos,
+						false);
+		}
+	}
+}
+
+static void hive_gen_init(struct hive_generator *g, const Hive *hive,
+		HiveMoveCache *cache, HiveMoveList *list)
+{
+	/* the perimeter is big and only read once it is built */
+	memset(g, 0, offsetof(struct hive_generator, perimeter));
+	g->hive = hive;
+	g->cache = cache;
+	g->board = &hive->board;
+	g->list = list;
+	g->wantMoves = true;
+	g->wantThrows = true;
+	hive_move_list_clear(list);
+}
+
+void hive_generatemoves(const Hive *hive, HiveMoveCache *cache,
+		HiveMoveList *list)
+{
+	struct hive_generator g;
+	const HiveRegion *inventory;
+	uint32_t types;
+
+	hive_gen_init(&g, hive, cache, list);
+	inventory = hive->turn == HIVE_WHITE ? &hive->whiteInventory :
+		&hive->blackInventory;
+	/* pieces of the same type are interchangeable, so only place one */
+	types = 0;
+	for (size_t i = 0; i < inventory->numPieces; i++) {
+		const HivePiece *const piece = inventory->pieces[i];
+		if (types & (1 << piece->type))
+			continue;
+		types |= 1 << piece->type;
+		hive_gen_window(&g);
+		hive_gen_placements(&g, piece);
+	}
+
+	if (hive_isqueensurrounded(hive))
+		return;
+
+	/* first all moves of the pieces themselves, then all throws, this
+	 * way duplicates only need to be searched for in small windows
+	 */
+	g.wantThrows = false;
+	for (size_t i = 0; i < g.board->numPieces; i++) {
+		const HivePiece *const piece = g.board->pieces[i];
+		if (!hive_gen_ismovable(&g, piece))
+			continue;
+		hive_gen_window(&g);
+		hive_gen_own(&g, piece, hive_gen_canmoveaway(&g, piece));
+	}
+
+	g.wantMoves = false;
+	g.wantThrows = true;
+	hive_gen_window(&g);
+	for (size_t i = 0; i < g.board->numPieces; i++) {
+		const HivePiece *const piece = g.board->pieces[i];
+		if (piece->type != HIVE_PILLBUG &&
+				piece->type != HIVE_MOSQUITO)
+			continue;
+		if (!hive_gen_ismovable(&g, piece))
+			continue;
+		hive_gen_type(&g, piece, piece->type,
+				hive_gen_canmoveaway(&g, piece));
+	}
+}
+
+void hive_generatepiecemoves(const Hive *hive, HiveMoveCache *cache,
+		const HivePiece *piece, enum hive_type type,
+		HiveMoveList *list)
+{
+	struct hive_generator g;
+
+	hive_gen_init(&g, hive, cache, list);
+	if (hive_isqueensurrounded(hive) || !hive_gen_ismovable(&g, piece))
+		return;
+	if (type == piece->type)
+		hive_gen_own(&g, piece, hive_gen_canmoveaway(&g, piece));
+	else
+		hive_gen_type(&g, piece, type, hive_gen_canmoveaway(&g, piece));
+}
+
+void hive_generateplacements(const Hive *hive, const HivePiece *piece,
+		HiveMoveList *list)
+{
+	struct hive_generator g;
+
+	hive_gen_init(&g, hive, NULL, list);
+	hive_gen_placements(&g, piece);
+}
+
+void hive_generatethrows(const Hive *hive, const HivePiece *actor,
+		const HivePiece *piece, HiveMoveList *list)
+{
+	struct hive_generator g;
+	int dir;
+
+	hive_gen_init(&g, hive, NULL, list);
+	if (hive_isqueensurrounded(hive) || !hive_gen_ismovable(&g, actor))
+		return;
+	for (dir = 0; dir < 6; dir++) {
+		Point p;
+
+		p = piece->position;
+		hive_movepoint(&p, dir);
+		if (point_isequal(p, actor->position))
+			break;
+	}
+	if (dir == 6)
+		return;
+	g.hasMover = true;
+	g.lifted = actor->position;
+	g.raised = actor->position;
+	/* dir points from the piece to the actor, the direction from the
+	 * actor to the piece is the opposite one
+	 */
+	if (hive_gen_cancarry(&g, actor, piece, hive_oppositedirection(dir)))
+		hive_gen_carry(&g, actor, piece);
+}
+
+bool hive_issurrounded(const Hive *hive, enum hive_side side)
+{
+	return hive->eval.hasQueen[side] && hive->eval.queenNeighbors[side] == 6;
+}
+
+bool hive_isqueensurrounded(const Hive *hive)
+{
+	return hive_issurrounded(hive, hive->turn);
+}
@@ -0,0 +1,286 @@
+#include "hex.h"
+
+struct hive_tarjan {
+	const HiveGraph *graph;
+	/* only vertices of this set are looked at */
+	uint64_t within;
+	uint32_t time;
+	uint64_t visited;
+	uint32_t discovered[HIVE_CELL_COUNT];
+	uint32_t low[HIVE_CELL_COUNT];
+	/* vertices that are not part of a finished block yet */
+	uint32_t stack[HIVE_CELL_COUNT];
+	uint32_t numStack;
+	uint64_t *blocks;
+	uint32_t numBlocks;
+};
+
+/* the depth is bounded by the number of pieces, so recursing is fine */
+static void hive_tarjan_visit(struct hive_tarjan *t, uint32_t v, int parent)
+{
+	t->visited |= (uint64_t) 1 << v;
+	t->discovered[v] = t->low[v] = ++t->time;
+	t->stack[t->numStack++] = v;
+	for (uint64_t n = t->graph->adjacent[v] & t->within; n != 0;
+			n &= n - 1) {
+		const uint32_t u = __builtin_ctzll(n);
+		if (t->visited & ((uint64_t) 1 << u)) {
+			if ((int) u != parent)
+				t->low[v] = MIN(t->low[v], t->discovered[u]);
+			continue;
+		}
+		hive_tarjan_visit(t, u, v);
+		t->low[v] = MIN(t->low[v], t->low[u]);
+		/* nothing below u reaches above v, so v and everything
+		 * that was found from u on make up a block
+		 */
+		if (t->low[u] >= t->discovered[v]) {
+			uint64_t block = (uint64_t) 1 << v;
+			uint32_t w;
+
+			do {
+				w = t->stack[--t->numStack];
+				block |= (uint64_t) 1 << w;
+			} while (w != u);
+			t->blocks[t->numBlocks++] = block;
+		}
+	}
+}
+
+/* appends the blocks of the subgraph induced by within to the blocks of
+ * the graph and returns the vertices reached from root
+ */
+static uint64_t hive_graph_findblocks(HiveGraph *graph, uint64_t within,
+		uint32_t root)
+{
+	struct hive_tarjan t;
+
+	t.graph = graph;
+	t.within = within;
+	t.time = 0;
+	t.visited = 0;
+	t.numStack = 0;
+	t.blocks = graph->blocks;
+	t.numBlocks = graph->numBlocks;
+	hive_tarjan_visit(&t, root, -1);
+	graph->numBlocks = t.numBlocks;
+	return t.visited;
+}
+
+/* a vertex is a cut vertex if it is part of more than one block */
+static void hive_graph_findcuts(HiveGraph *graph)
+{
+	uint64_t seen = 0;
+
+	graph->cuts = 0;
+	for (uint32_t b = 0; b < graph->numBlocks; b++) {
+		graph->cuts |= seen & graph->blocks[b];
+		seen |= graph->blocks[b];
+	}
+}
+
+void hive_graph_recompute(HiveGraph *graph)
+{
+	uint64_t left;
+
+	graph->numBlocks = 0;
+	left = graph->vertices;
+	graph->isConnected = true;
+	while (left != 0) {
+		left &= ~hive_graph_findblocks(graph, graph->vertices,
+				__builtin_ctzll(left));
+		if (left != 0)
+			graph->isConnected = false;
+	}
+	hive_graph_findcuts(graph);
+}
+
+#ifndef NDEBUG
+static bool hive_graph_hasblock(const HiveGraph *graph, uint64_t block)
+{
+	for (uint32_t b = 0; b < graph->numBlocks; b++)
+		if (graph->blocks[b] == block)
+			return true;
+	return false;
+}
+
+/* the incremental updates must end up where a full recompute does */
+static void hive_graph_check(const HiveGraph *graph)
+{
+	HiveGraph full;
+
+	full = *graph;
+	hive_graph_recompute(&full);
+	assert(full.isConnected == graph->isConnected);
+	assert(full.cuts == graph->cuts);
+	assert(full.numBlocks == graph->numBlocks);
+	for (uint32_t b = 0; b < full.numBlocks; b++)
+		assert(hive_graph_hasblock(graph, full.blocks[b]));
+}
+#else
+#define hive_graph_check(graph) ((void) 0)
+#endif
+
+static void hive_graph_dropblock(HiveGraph *graph, uint32_t b)
+{
+	graph->blocks[b] = graph->blocks[--graph->numBlocks];
+}
+
+/* The blocks and the cut vertices form a tree. A new vertex joins all
+ * blocks on the paths between its neighbors into one, these are found by
+ * cutting off leaves of the tree that are no neighbors until none are
+ * left.
+ */
+static void hive_graph_joinblocks(HiveGraph *graph, uint32_t vertex,
+		uint64_t neighbors)
+{
+	uint64_t terminals = 0;
+	uint64_t blocks = 0;
+	uint64_t cuts;
+	uint64_t block;
+	bool changed;
+
+	/* a neighbor that is no cut vertex stands for its only block */
+	for (uint32_t b = 0; b < graph->numBlocks; b++)
+		if (graph->blocks[b] & neighbors & ~graph->cuts)
+			terminals |= (uint64_t) 1 << b;
+	cuts = graph->cuts;
+	for (uint32_t b = 0; b < graph->numBlocks; b++)
+		blocks |= (uint64_t) 1 << b;
+	do {
+		changed = false;
+		for (uint32_t b = 0; b < graph->numBlocks; b++) {
+			if (!(blocks & ((uint64_t) 1 << b)) ||
+					(terminals & ((uint64_t) 1 << b)))
+				continue;
+			const uint64_t c = graph->blocks[b] & cuts;
+			if (c & (c - 1))
+				continue;
+			blocks &= ~((uint64_t) 1 << b);
+			changed = true;
+		}
+		for (uint64_t c = cuts & ~neighbors; c != 0; c &= c - 1) {
+			const uint32_t v = __builtin_ctzll(c);
+			uint32_t degree = 0;
+
+			for (uint32_t b = 0; b < graph->numBlocks; b++)
+				if ((blocks & ((uint64_t) 1 << b)) &&
+						(graph->blocks[b] &
+						 ((uint64_t) 1 << v)))
+					degree++;
+			if (degree > 1)
+				continue;
+			cuts &= ~((uint64_t) 1 << v);
+			changed = true;
+		}
+	} while (changed);
+
+	block = ((uint64_t) 1 << vertex) | neighbors;
+	for (uint32_t b = graph->numBlocks; b-- != 0; )
+		if (blocks & ((uint64_t) 1 << b)) {
+			block |= graph->blocks[b];
+			hive_graph_dropblock(graph, b);
+		}
+	graph->blocks[graph->numBlocks++] = block;
+}
+
+uint32_t hive_graph_addvertex(HiveGraph *graph, uint64_t neighbors)
+{
+	const uint32_t vertex = __builtin_ctzll(~graph->vertices);
+	const bool wasEmpty = graph->vertices == 0;
+
+	graph->vertices |= (uint64_t) 1 << vertex;
+	graph->stacked &= ~((uint64_t) 1 << vertex);
+	graph->adjacent[vertex] = neighbors;
+	for (uint64_t n = neighbors; n != 0; n &= n - 1)
+		graph->adjacent[__builtin_ctzll(n)] |= (uint64_t) 1 << vertex;
+
+	if (wasEmpty) {
+		graph->numBlocks = 0;
+		graph->cuts = 0;
+		graph->isConnected = true;
+		return vertex;
+	}
+	if (!graph->isConnected || neighbors == 0) {
+		hive_graph_recompute(graph);
+		return vertex;
+	}
+	if ((neighbors & (neighbors - 1)) == 0)
+		/* a new leaf hangs on a bridge */
+		graph->blocks[graph->numBlocks++] =
+			((uint64_t) 1 << vertex) | neighbors;
+	else
+		hive_graph_joinblocks(graph, vertex, neighbors);
+	hive_graph_findcuts(graph);
+	hive_graph_check(graph);
+	return vertex;
+}
+
+void hive_graph_removevertex(HiveGraph *graph, uint32_t vertex)
+{
+	const uint64_t bit = (uint64_t) 1 << vertex;
+	const bool isCut = (graph->cuts & bit) != 0;
+	uint64_t block;
+	uint32_t b;
+
+	for (uint64_t n = graph->adjacent[vertex]; n != 0; n &= n - 1)
+		graph->adjacent[__builtin_ctzll(n)] &= ~bit;
+	graph->adjacent[vertex] = 0;
+	graph->vertices &= ~bit;
+	graph->stacked &= ~bit;
+
+	/* taking away a cut vertex splits the graph, there is nothing to
+	 * be saved by updating then
+	 */
+	if (!graph->isConnected || isCut) {
+		hive_graph_recompute(graph);
+		return;
+	}
+	/* a vertex that is no cut vertex is part of at most one block and
+	 * only that one block can fall apart
+	 */
+	for (b = 0; b < graph->numBlocks; b++)
+		if (graph->blocks[b] & bit)
+			break;
+	if (b < graph->numBlocks) {
+		block = graph->blocks[b] & ~bit;
+		hive_graph_dropblock(graph, b);
+		if (block & (block - 1))
+			hive_graph_findblocks(graph, block,
+					__builtin_ctzll(block));
+	}
+	hive_graph_findcuts(graph);
+	hive_graph_check(graph);
+}
+
+/* moves the bit of a vertex in a set to another vertex */
+#define hive_graph_movebit(set, from, to) ((set) = ((set) & ~(from)) | \
+		((set) & (from) ? (to) : 0))
+
+void hive_graph_movevertex(HiveGraph *graph, uint32_t from, uint32_t to)
+{
+	const uint64_t f = (uint64_t) 1 << from, t = (uint64_t) 1 << to;
+
+	assert(!(graph->vertices & t));
+	graph->adjacent[to] = graph->adjacent[from];
+	graph->adjacent[from] = 0;
+	for (uint64_t n = graph->adjacent[to]; n != 0; n &= n - 1)
+		hive_graph_movebit(graph->adjacent[__builtin_ctzll(n)], f, t);
+	hive_graph_movebit(graph->vertices, f, t);
+	hive_graph_movebit(graph->stacked, f, t);
+	hive_graph_movebit(graph->cuts, f, t);
+	for (uint32_t b = 0; b < graph->numBlocks; b++)
+		hive_graph_movebit(graph->blocks[b], f, t);
+	hive_graph_check(graph);
+}
+
+uint64_t hive_graph_articulations(const HiveGraph *graph)
+{
+	return graph->isConnected ? graph->cuts : graph->vertices;
+}
+
+uint64_t hive_graph_pinned(const HiveGraph *graph)
+{
+	/* lifting the top of a stack leaves the cell occupied */
+	return hive_graph_articulations(graph) & ~graph->stacked;
+}
@@ -0,0 +1,245 @@
+#include "hex.h"
+
+/* The board has no fixed size, so instead of a table of random numbers the
+ * keys are derived from what they stand for with a strong mixing function.
+ * Pieces of the same type and side are interchangeable and get the same
+ * keys.
+ */
+static uint64_t hive_hash_mix(uint64_t x)
+{
+	/* splitmix64 */
+	x += 0x9e3779b97f4a7c15;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+
+enum {
+	HIVE_HASH_PIECE,
+	HIVE_HASH_INVENTORY,
+	HIVE_HASH_IMMOBILE,
+	HIVE_HASH_TURN,
+};
+
+static uint64_t hive_hash_pack(uint64_t what, Point at, uint64_t a, uint64_t b,
+		uint64_t c)
+{
+	return (uint64_t) (uint16_t) at.x | (uint64_t) (uint16_t) at.y << 16 |
+		a << 32 | b << 40 | c << 48 | what << 56;
+}
+
+uint64_t hive_hash_piece(const HivePiece *piece, Point at, uint32_t level)
+{
+	return hive_hash_mix(hive_hash_pack(HIVE_HASH_PIECE, at,
+				level, piece->type, piece->side));
+}
+
+uint64_t hive_hash_inventory(enum hive_side side, enum hive_type type,
+		uint32_t count)
+{
+	return hive_hash_mix(hive_hash_pack(HIVE_HASH_INVENTORY,
+				(Point) { 0, 0 }, count, type, side));
+}
+
+uint64_t hive_hash_immobile(Point at)
+{
+	return hive_hash_mix(hive_hash_pack(HIVE_HASH_IMMOBILE, at, 0, 0, 0));
+}
+
+uint64_t hive_hash_turn(void)
+{
+	return hive_hash_mix(hive_hash_pack(HIVE_HASH_TURN,
+				(Point) { 0, 0 }, 0, 0, 0));
+}
+
+uint32_t hive_hash_countinventory(const HiveRegion *inventory,
+		enum hive_type type)
+{
+	uint32_t cnt = 0;
+
+	for (size_t i = 0; i < inventory->numPieces; i++)
+		if (inventory->pieces[i]->type == type)
+			cnt++;
+	return cnt;
+}
+
+/* the part of the hash that is not on the board */
+static uint64_t hive_hash_offboard(const Hive *hive)
+{
+	uint64_t hash = 0;
+
+	for (int s = 0; s < 2; s++) {
+		const HiveRegion *const inventory = s == HIVE_WHITE ?
+			&hive->whiteInventory : &hive->blackInventory;
+		for (int t = 0; t < HIVE_PILLBUG_CARRYING; t++)
+			hash ^= hive_hash_inventory(s, t,
+				hive_hash_countinventory(inventory, t));
+	}
+	if (hive->turn == HIVE_WHITE)
+		hash ^= hive_hash_turn();
+	return hash;
+}
+
+uint64_t hive_computehash(const Hive *hive)
+{
+	const HiveRegion *const board = &hive->board;
+	uint64_t hash = hive_hash_offboard(hive);
+
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &board->cells[i];
+		for (uint32_t l = 0; l < cell->count; l++) {
+			const HivePiece *const piece = cell->stack[l];
+			hash ^= hive_hash_piece(piece, cell->position, l);
+			if (piece->flags & HIVE_IMMOBILE)
+				hash ^= hive_hash_immobile(cell->position);
+		}
+	}
+	return hash;
+}
+
+/* the symmetries as matrices on axial coordinates: a sixth of a turn is
+ * (q, r) -> (-r, q + r) and the mirror swaps q and r
+ */
+static const int hive_symmetries[12][2][2] = {
+	{ {  1,  0 }, {  0,  1 } },
+	{ {  0, -1 }, {  1,  1 } },
+	{ { -1, -1 }, {  1,  0 } },
+	{ { -1,  0 }, {  0, -1 } },
+	{ {  0,  1 }, { -1, -1 } },
+	{ {  1,  1 }, { -1,  0 } },
+	{ {  0,  1 }, {  1,  0 } },
+	{ { -1,  0 }, {  1,  1 } },
+	{ { -1, -1 }, {  0,  1 } },
+	{ {  0, -1 }, { -1,  0 } },
+	{ {  1,  0 }, { -1, -1 } },
+	{ {  1,  1 }, {  0, -1 } },
+};
+
+static Point hive_symmetry_transform(uint32_t transform, int q, int r)
+{
+	const int (*const m)[2] = hive_symmetries[transform];
+
+	return (Point) { m[0][0] * q + m[0][1] * r, m[1][0] * q + m[1][1] * r };
+}
+
+Point hive_symmetry_apply(const HiveSymmetry *symmetry, Point at)
+{
+	Point p;
+
+	p = hive_symmetry_transform(symmetry->transform, at.x,
+			at.y - (at.x >> 1));
+	point_subtract(&p, symmetry->origin);
+	return p;
+}
+
+/* a cheaper mix for the canonical hash, the content of a cell is mixed
+ * well already
+ */
+static uint64_t hive_hash_cell(uint64_t content, Point at)
+{
+	uint64_t x;
+
+	x = content ^ ((uint64_t) (uint32_t) at.x << 32 |
+			(uint32_t) at.y) * 0x9e3779b97f4a7c15;
+	x ^= x >> 32;
+	x *= 0xd6e8feb86659fd93;
+	return x ^ (x >> 32);
+}
+
+uint64_t hive_computecanonical(const Hive *hive, HiveSymmetry *symmetry)
+{
+	const HiveRegion *const board = &hive->board;
+	Point axials[HIVE_PIECE_COUNT];
+	uint64_t contents[HIVE_PIECE_COUNT];
+	Point points[HIVE_PIECE_COUNT];
+	size_t numCells = 0;
+	int64_t sum[2] = { 0, 0 }, weighted[2] = { 0, 0 }, weights = 0;
+	int64_t moment[2], first[2] = { 0, 0 };
+	uint64_t best = 0;
+	bool hasBest = false;
+	HiveSymmetry s;
+
+	/* what is on a cell does not change with the symmetry */
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &board->cells[i];
+		uint64_t content = 0;
+		int64_t weight;
+
+		if (cell->count == 0)
+			continue;
+		for (uint32_t l = 0; l < cell->count; l++) {
+			const HivePiece *const piece = cell->stack[l];
+			content ^= hive_hash_piece(piece, (Point) { 0, 0 }, l);
+			if (piece->flags & HIVE_IMMOBILE)
+				content ^= hive_hash_immobile((Point) { 0, 0 });
+		}
+		const Point axial = {
+			cell->position.x,
+			cell->position.y - (cell->position.x >> 1),
+		};
+		weight = (content >> 48) + 1;
+		sum[0] += axial.x;
+		sum[1] += axial.y;
+		weighted[0] += weight * axial.x;
+		weighted[1] += weight * axial.y;
+		weights += weight;
+		axials[numCells] = axial;
+		contents[numCells++] = content;
+	}
+
+	/* The weighted cells around their middle, this does not depend on
+	 * where the position lies and turns with the position. Only the
+	 * symmetries that turn it to the smallest vector need to be hashed,
+	 * that is one or two unless the position is very regular.
+	 */
+	moment[0] = (int64_t) numCells * weighted[0] - weights * sum[0];
+	moment[1] = (int64_t) numCells * weighted[1] - weights * sum[1];
+	for (s.transform = 0; s.transform < 12; s.transform++) {
+		const int (*const m)[2] = hive_symmetries[s.transform];
+		const int64_t v[2] = {
+			m[0][0] * moment[0] + m[0][1] * moment[1],
+			m[1][0] * moment[0] + m[1][1] * moment[1],
+		};
+		if (s.transform == 0 || v[0] < first[0] ||
+				(v[0] == first[0] && v[1] < first[1])) {
+			first[0] = v[0];
+			first[1] = v[1];
+		}
+	}
+
+	for (s.transform = 0; s.transform < 12; s.transform++) {
+		const int (*const m)[2] = hive_symmetries[s.transform];
+		uint64_t hash = 0;
+
+		if (m[0][0] * moment[0] + m[0][1] * moment[1] != first[0] ||
+				m[1][0] * moment[0] + m[1][1] * moment[1] !=
+				first[1])
+			continue;
+		s.origin = (Point) { 0, 0 };
+		/* the cell that comes first after the transform is the
+		 * origin
+		 */
+		for (size_t c = 0; c < numCells; c++) {
+			points[c] = hive_symmetry_transform(s.transform,
+					axials[c].x, axials[c].y);
+			if (c == 0 || points[c].x < s.origin.x ||
+					(points[c].x == s.origin.x &&
+					 points[c].y < s.origin.y))
+				s.origin = points[c];
+		}
+		for (size_t c = 0; c < numCells; c++) {
+			Point at;
+
+			at = points[c];
+			point_subtract(&at, s.origin);
+			hash ^= hive_hash_cell(contents[c], at);
+		}
+		if (!hasBest || hash < best) {
+			best = hash;
+			hasBest = true;
+			if (symmetry != NULL)
+				*symmetry = s;
+		}
+	}
+	return best ^ hive_hash_offboard(hive);
+}
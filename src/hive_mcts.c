@@ -0,0 +1,405 @@
+#include "hex.h"
+
+/* deepest walk through the tree */
+#define HIVE_MCTS_MAX_DEPTH 128
+/* a playout that goes on for longer is decided by the evaluation */
+#define HIVE_MCTS_PLAYOUT 40
+#define HIVE_MCTS_EXPLORATION 1.4
+
+/* a move or a pass that can be taken back */
+struct hive_mcts_step {
+	bool isPass;
+	HiveUndo undo;
+};
+
+struct hive_mcts_thread {
+	pthread_t thread;
+	bool isRunning;
+	HiveMcts *mcts;
+	Hive hive;
+	HiveMoveList moves;
+	uint64_t random;
+	uint32_t path[HIVE_MCTS_MAX_DEPTH + 1];
+	/* who made the move into each node of the path */
+	enum hive_side movers[HIVE_MCTS_MAX_DEPTH + 1];
+	struct hive_mcts_step steps[HIVE_MCTS_MAX_DEPTH + HIVE_MCTS_PLAYOUT];
+	uint32_t numSteps;
+};
+
+static double hive_mcts_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t hive_mcts_random(struct hive_mcts_thread *t)
+{
+	/* xorshift64 */
+	t->random ^= t->random << 13;
+	t->random ^= t->random >> 7;
+	t->random ^= t->random << 17;
+	return t->random >> 32;
+}
+
+int hive_mcts_init(HiveMcts *mcts, size_t megabytes)
+{
+	memset(mcts, 0, sizeof(*mcts));
+	mcts->numNodes = MIN((megabytes << 20) / sizeof(*mcts->nodes),
+			(size_t) UINT32_MAX);
+	if (mcts->numNodes == 0)
+		return -1;
+	mcts->nodes = malloc(sizeof(*mcts->nodes) * mcts->numNodes);
+	return mcts->nodes == NULL ? -1 : 0;
+}
+
+void hive_mcts_free(HiveMcts *mcts)
+{
+	free(mcts->nodes);
+	mcts->nodes = NULL;
+}
+
+static void hive_mcts_play(struct hive_mcts_thread *t, const HiveMove *move,
+		bool isPass)
+{
+	struct hive_mcts_step *const step = &t->steps[t->numSteps++];
+
+	step->isPass = isPass;
+	if (isPass) {
+		t->hive.turn = !t->hive.turn;
+		t->hive.hash ^= hive_hash_turn();
+	} else {
+		hive_makemove(&t->hive, move, &step->undo);
+	}
+}
+
+static void hive_mcts_takeback(struct hive_mcts_thread *t)
+{
+	while (t->numSteps > 0) {
+		const struct hive_mcts_step *const step =
+			&t->steps[--t->numSteps];
+		if (step->isPass) {
+			t->hive.turn = !t->hive.turn;
+			t->hive.hash ^= hive_hash_turn();
+		} else {
+			hive_undomove(&t->hive, &step->undo);
+		}
+	}
+}
+
+/* the result for the side to move in points (see HiveMctsNode.score) or
+ * -1 if the game goes on
+ */
+static int hive_mcts_result(const Hive *hive)
+{
+	const bool own = hive_issurrounded(hive, hive->turn);
+	const bool other = hive_issurrounded(hive, !hive->turn);
+
+	if (own && other)
+		return 1;
+	if (own)
+		return 0;
+	if (other)
+		return 2;
+	return -1;
+}
+
+/* picks a random piece type to place or a random piece to move and only
+ * generates the moves of that one, another one is picked if it has none;
+ * this is a lot cheaper than generating all moves and the playout does
+ * not need every move to be equally likely; false if nothing can move
+ */
+static bool hive_mcts_randommove(struct hive_mcts_thread *t)
+{
+	const Hive *const hive = &t->hive;
+	const HiveRegion *const inventory = hive->turn == HIVE_WHITE ?
+		&hive->whiteInventory : &hive->blackInventory;
+	/* the first numPlaces are placements */
+	const HivePiece *pieces[HIVE_PIECE_COUNT];
+	uint32_t count = 0, numPlaces, types = 0;
+
+	/* pieces of the same type are interchangeable, so only place one */
+	for (size_t i = 0; i < inventory->numPieces; i++) {
+		const HivePiece *const piece = inventory->pieces[i];
+		if (types & (1 << piece->type))
+			continue;
+		types |= 1 << piece->type;
+		pieces[count++] = piece;
+	}
+	numPlaces = count;
+	for (size_t i = 0; i < hive->board.numPieces; i++) {
+		const HivePiece *const piece = hive->board.pieces[i];
+		if (piece->side == hive->turn &&
+				!(piece->flags & HIVE_IMMOBILE))
+			pieces[count++] = piece;
+	}
+
+	while (count > 0) {
+		const uint32_t i = hive_mcts_random(t) % count;
+
+		if (i < numPlaces)
+			hive_generateplacements(hive, pieces[i], &t->moves);
+		else
+			hive_generatepiecemoves(hive, NULL, pieces[i],
+					pieces[i]->type, &t->moves);
+		if (t->moves.count > 0) {
+			hive_mcts_play(t, &t->moves.moves[
+				hive_mcts_random(t) % t->moves.count], false);
+			return true;
+		}
+		/* keep the placements in front */
+		if (i < numPlaces) {
+			pieces[i] = pieces[--numPlaces];
+			pieces[numPlaces] = pieces[--count];
+		} else {
+			pieces[i] = pieces[--count];
+		}
+	}
+	return false;
+}
+
+/* plays random moves until the game ends or the evaluation has to
+ * decide
+ */
+static int hive_mcts_playout(struct hive_mcts_thread *t,
+		enum hive_side *side)
+{
+	Hive *const hive = &t->hive;
+	int result;
+	int score;
+
+	for (uint32_t p = 0; p < HIVE_MCTS_PLAYOUT; p++) {
+		result = hive_mcts_result(hive);
+		if (result >= 0) {
+			*side = hive->turn;
+			return result;
+		}
+		if (!hive_mcts_randommove(t))
+			hive_mcts_play(t, NULL, true);
+	}
+	*side = hive->turn;
+	result = hive_mcts_result(hive);
+	if (result >= 0)
+		return result;
+	score = hive_evaluate(hive);
+	return score > 0 ? 2 : score < 0 ? 0 : 1;
+}
+
+static uint32_t hive_mcts_select(const HiveMcts *mcts,
+		const HiveMctsNode *node)
+{
+	const uint32_t parentVisits = __atomic_load_n(&node->visits,
+			__ATOMIC_RELAXED);
+	const double logVisits = log(MAX(parentVisits, (uint32_t) 1));
+	double bestValue = -1;
+	uint32_t best = node->firstChild;
+
+	for (uint32_t i = 0; i < node->numChildren; i++) {
+		const HiveMctsNode *const child =
+			&mcts->nodes[node->firstChild + i];
+		const uint32_t visits = __atomic_load_n(&child->visits,
+				__ATOMIC_RELAXED);
+		const uint32_t score = __atomic_load_n(&child->score,
+				__ATOMIC_RELAXED);
+		double value;
+
+		/* everything is tried once before anything twice */
+		if (visits == 0)
+			return node->firstChild + i;
+		value = score / (2.0 * visits) + HIVE_MCTS_EXPLORATION *
+			sqrt(logVisits / visits);
+		if (value > bestValue) {
+			bestValue = value;
+			best = node->firstChild + i;
+		}
+	}
+	return best;
+}
+
+/* only one thread adds the children of a node, the others play out from
+ * the node meanwhile
+ */
+static bool hive_mcts_expand(struct hive_mcts_thread *t, HiveMctsNode *node)
+{
+	HiveMcts *const mcts = t->mcts;
+	uint8_t expected = HIVE_MCTS_LEAF;
+	uint32_t count, first;
+
+	if (!__atomic_compare_exchange_n(&node->state, &expected,
+				HIVE_MCTS_EXPANDING, false, __ATOMIC_ACQUIRE,
+				__ATOMIC_RELAXED))
+		return false;
+	hive_generatemoves(&t->hive, NULL, &t->moves);
+	/* a side that can't move passes */
+	count = MAX(t->moves.count, (size_t) 1);
+	/* the nodes are only taken if all children fit, so usedNodes never
+	 * goes past the end of the pool
+	 */
+	first = __atomic_load_n(&mcts->usedNodes, __ATOMIC_RELAXED);
+	do {
+		if (count > mcts->numNodes - first) {
+			__atomic_store_n(&mcts->isFull, true, __ATOMIC_RELAXED);
+			__atomic_store_n(&node->state, HIVE_MCTS_FULL,
+					__ATOMIC_RELEASE);
+			return false;
+		}
+	} while (!__atomic_compare_exchange_n(&mcts->usedNodes, &first,
+				first + count, true, __ATOMIC_RELAXED,
+				__ATOMIC_RELAXED));
+	for (uint32_t i = 0; i < count; i++) {
+		HiveMctsNode *const child = &mcts->nodes[first + i];
+		memset(child, 0, sizeof(*child));
+		child->isPass = t->moves.count == 0;
+		if (!child->isPass)
+			child->move = t->moves.moves[i];
+	}
+	node->firstChild = first;
+	node->numChildren = count;
+	__atomic_store_n(&node->state, HIVE_MCTS_EXPANDED, __ATOMIC_RELEASE);
+	return true;
+}
+
+static void hive_mcts_iterate(struct hive_mcts_thread *t)
+{
+	HiveMcts *const mcts = t->mcts;
+	Hive *const hive = &t->hive;
+	uint32_t depth = 0;
+	uint32_t index = 0;
+	enum hive_side side;
+	int result;
+
+	t->path[0] = 0;
+	t->movers[0] = !hive->turn;
+	__atomic_fetch_add(&mcts->nodes[0].visits, 1, __ATOMIC_RELAXED);
+	while ((result = hive_mcts_result(hive)) < 0) {
+		HiveMctsNode *const node = &mcts->nodes[index];
+		const uint8_t state = __atomic_load_n(&node->state,
+				__ATOMIC_ACQUIRE);
+
+		if (depth == HIVE_MCTS_MAX_DEPTH || state == HIVE_MCTS_FULL ||
+				state == HIVE_MCTS_EXPANDING)
+			break;
+		if (state == HIVE_MCTS_LEAF) {
+			/* a node is expanded on its second visit */
+			if (__atomic_load_n(&node->visits,
+					__ATOMIC_RELAXED) <= 1 ||
+					!hive_mcts_expand(t, node))
+				break;
+		}
+		index = hive_mcts_select(mcts, node);
+		HiveMctsNode *const child = &mcts->nodes[index];
+		/* the virtual loss */
+		__atomic_fetch_add(&child->visits, 1, __ATOMIC_RELAXED);
+		t->movers[++depth] = hive->turn;
+		t->path[depth] = index;
+		hive_mcts_play(t, &child->move, child->isPass);
+	}
+	if (result >= 0)
+		side = hive->turn;
+	else
+		result = hive_mcts_playout(t, &side);
+	hive_mcts_takeback(t);
+
+	for (uint32_t d = 0; d <= depth; d++)
+		__atomic_fetch_add(&mcts->nodes[t->path[d]].score,
+				t->movers[d] == side ? result : 2 - result,
+				__ATOMIC_RELAXED);
+}
+
+/* does one playout and checks if that was the last one */
+static bool hive_mcts_step(struct hive_mcts_thread *t)
+{
+	HiveMcts *const mcts = t->mcts;
+	uint64_t playouts;
+
+	hive_mcts_iterate(t);
+	playouts = __atomic_add_fetch(&mcts->playouts, 1, __ATOMIC_RELAXED);
+	if ((mcts->limits.playouts != 0 && playouts >= mcts->limits.playouts) ||
+			(mcts->limits.seconds <= 0 &&
+			 mcts->limits.playouts == 0 &&
+			 __atomic_load_n(&mcts->isFull, __ATOMIC_RELAXED)))
+		__atomic_store_n(&mcts->stop, true, __ATOMIC_RELAXED);
+	return !__atomic_load_n(&mcts->stop, __ATOMIC_RELAXED);
+}
+
+static void *hive_mcts_work(void *arg)
+{
+	struct hive_mcts_thread *const t = arg;
+
+	while (hive_mcts_step(t))
+		(void) 0;
+	return NULL;
+}
+
+int hive_mcts_run(HiveMcts *mcts, const Hive *hive, uint32_t numThreads,
+		const HiveMctsLimits *limits, HiveMctsResult *result)
+{
+	struct hive_mcts_thread *threads;
+	const HiveMctsNode *root;
+	uint32_t numInit;
+	double start;
+
+	memset(result, 0, sizeof(*result));
+	numThreads = MAX(numThreads, (uint32_t) 1);
+	threads = calloc(numThreads, sizeof(*threads));
+	if (threads == NULL)
+		return -1;
+	for (numInit = 0; numInit < numThreads; numInit++) {
+		struct hive_mcts_thread *const t = &threads[numInit];
+		if (hive_copy(&t->hive, hive) < 0)
+			break;
+		t->mcts = mcts;
+		t->random = 0x9e3779b97f4a7c15 * (numInit + 1);
+	}
+	if (numInit == 0) {
+		free(threads);
+		return -1;
+	}
+
+	memset(&mcts->nodes[0], 0, sizeof(mcts->nodes[0]));
+	mcts->usedNodes = 1;
+	mcts->isFull = false;
+	mcts->limits = *limits;
+	mcts->playouts = 0;
+	mcts->stop = false;
+	start = hive_mcts_now();
+	for (uint32_t i = 1; i < numInit; i++)
+		threads[i].isRunning = pthread_create(&threads[i].thread, NULL,
+				hive_mcts_work, &threads[i]) == 0;
+	/* the calling thread keeps the time */
+	while (hive_mcts_step(&threads[0]))
+		if (limits->seconds > 0 &&
+				hive_mcts_now() - start >= limits->seconds)
+			__atomic_store_n(&mcts->stop, true, __ATOMIC_RELAXED);
+	for (uint32_t i = 1; i < numInit; i++)
+		if (threads[i].isRunning)
+			pthread_join(threads[i].thread, NULL);
+
+	/* the most tried move is the most trusted */
+	root = &mcts->nodes[0];
+	if (root->state == HIVE_MCTS_EXPANDED) {
+		const HiveMctsNode *best = NULL;
+		for (uint32_t i = 0; i < root->numChildren; i++) {
+			const HiveMctsNode *const child =
+				&mcts->nodes[root->firstChild + i];
+			if (best == NULL || child->visits > best->visits)
+				best = child;
+		}
+		result->hasMove = !best->isPass;
+		result->move = best->move;
+		result->visits = best->visits;
+		result->winRate = best->visits == 0 ? 0 :
+			best->score / (2.0 * best->visits);
+	}
+	result->playouts = mcts->playouts;
+	result->seconds = hive_mcts_now() - start;
+	result->numNodes = mcts->usedNodes;
+
+	for (uint32_t i = 0; i < numInit; i++) {
+		free(threads[i].moves.moves);
+		hive_free(&threads[i].hive);
+	}
+	free(threads);
+	return 0;
+}
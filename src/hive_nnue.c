@@ -0,0 +1,376 @@
+#include "hex.h"
+
+/* the outputs of the hidden layer are divided by 1 << HIVE_NNUE_SHIFT and
+ * the output by HIVE_NNUE_SCALE
+ */
+#define HIVE_NNUE_SHIFT 6
+#define HIVE_NNUE_SCALE 16
+#define HIVE_NNUE_DIAMETER (2 * HIVE_NNUE_RADIUS + 1)
+
+HiveNnue hive_nnue;
+
+/* the feature cell of each axial offset from a queen or -1 */
+static int8_t hive_nnue_cells[HIVE_NNUE_DIAMETER][HIVE_NNUE_DIAMETER];
+
+static void hive_nnue_initcells(void)
+{
+	int8_t next = 0;
+
+	for (int q = -HIVE_NNUE_RADIUS; q <= HIVE_NNUE_RADIUS; q++)
+		for (int r = -HIVE_NNUE_RADIUS; r <= HIVE_NNUE_RADIUS; r++)
+			hive_nnue_cells[q + HIVE_NNUE_RADIUS]
+					[r + HIVE_NNUE_RADIUS] =
+				abs(q + r) <= HIVE_NNUE_RADIUS ? next++ : -1;
+	assert(next == HIVE_NNUE_CELLS);
+}
+
+int hive_nnue_load(const char *path)
+{
+	const size_t size = sizeof(HiveNnueHeader) +
+		sizeof(int16_t) * HIVE_NNUE_FEATURES * HIVE_NNUE_HIDDEN +
+		sizeof(int16_t) * HIVE_NNUE_HIDDEN +
+		sizeof(int8_t) * HIVE_NNUE_HIDDEN2 * 2 * HIVE_NNUE_HIDDEN +
+		sizeof(int32_t) * HIVE_NNUE_HIDDEN2 +
+		sizeof(int8_t) * HIVE_NNUE_HIDDEN2;
+	const HiveNnueHeader *header;
+	const char *data;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size != size) {
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+	header = map;
+	if (memcmp(header->magic, HIVE_NNUE_MAGIC, sizeof(header->magic)) ||
+			header->features != HIVE_NNUE_FEATURES ||
+			header->hidden != HIVE_NNUE_HIDDEN ||
+			header->hidden2 != HIVE_NNUE_HIDDEN2) {
+		munmap(map, size);
+		return -1;
+	}
+
+	hive_nnue_unload();
+	hive_nnue_initcells();
+	hive_nnue.map = map;
+	hive_nnue.size = size;
+	data = (const char*) map + sizeof(*header);
+	hive_nnue.featureWeights = (const int16_t*) data;
+	data += sizeof(int16_t) * HIVE_NNUE_FEATURES * HIVE_NNUE_HIDDEN;
+	hive_nnue.featureBias = (const int16_t*) data;
+	data += sizeof(int16_t) * HIVE_NNUE_HIDDEN;
+	hive_nnue.hiddenWeights = (const int8_t*) data;
+	data += sizeof(int8_t) * HIVE_NNUE_HIDDEN2 * 2 * HIVE_NNUE_HIDDEN;
+	hive_nnue.hiddenBias = (const int32_t*) data;
+	data += sizeof(int32_t) * HIVE_NNUE_HIDDEN2;
+	hive_nnue.outputWeights = (const int8_t*) data;
+	hive_nnue.outputBias = header->outputBias;
+
+	hive_nnue.kernel = HIVE_NNUE_SCALAR;
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx2"))
+		hive_nnue.kernel = HIVE_NNUE_AVX2;
+	else if (__builtin_cpu_supports("ssse3"))
+		hive_nnue.kernel = HIVE_NNUE_SSSE3;
+#endif
+	return 0;
+}
+
+void hive_nnue_unload(void)
+{
+	if (hive_nnue.map != NULL)
+		munmap(hive_nnue.map, hive_nnue.size);
+	memset(&hive_nnue, 0, sizeof(hive_nnue));
+}
+
+/* the feature of a piece from the view of the queen of a side or -1 if it
+ * is too far away
+ */
+static int hive_nnue_feature(enum hive_side side, Point queen,
+		const HivePiece *piece, Point at)
+{
+	const int q = at.x - queen.x;
+	const int r = at.y - (at.x >> 1) - queen.y + (queen.x >> 1);
+	int cell;
+
+	if (abs(q) > HIVE_NNUE_RADIUS || abs(r) > HIVE_NNUE_RADIUS)
+		return -1;
+	cell = hive_nnue_cells[q + HIVE_NNUE_RADIUS][r + HIVE_NNUE_RADIUS];
+	if (cell < 0)
+		return -1;
+	return ((piece->side != side) * HIVE_PILLBUG_CARRYING + piece->type) *
+		HIVE_NNUE_CELLS + cell;
+}
+
+static void hive_nnue_add(int16_t *values, int feature)
+{
+	const int16_t *const weights = &hive_nnue.featureWeights[
+		(size_t) feature * HIVE_NNUE_HIDDEN];
+
+	for (size_t i = 0; i < HIVE_NNUE_HIDDEN; i++)
+		values[i] += weights[i];
+}
+
+static void hive_nnue_subtract(int16_t *values, int feature)
+{
+	const int16_t *const weights = &hive_nnue.featureWeights[
+		(size_t) feature * HIVE_NNUE_HIDDEN];
+
+	for (size_t i = 0; i < HIVE_NNUE_HIDDEN; i++)
+		values[i] -= weights[i];
+}
+
+/* a side without its queen on the board sees nothing */
+static void hive_nnue_compute(const Hive *hive, enum hive_side side,
+		int16_t *values)
+{
+	const HiveRegion *const board = &hive->board;
+	const Point queen = hive->eval.queens[side];
+
+	memcpy(values, hive_nnue.featureBias,
+			sizeof(*values) * HIVE_NNUE_HIDDEN);
+	if (!hive->eval.hasQueen[side])
+		return;
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &board->cells[i];
+		for (uint32_t l = 0; l < cell->count; l++) {
+			const int feature = hive_nnue_feature(side, queen,
+					cell->stack[l], cell->position);
+			if (feature >= 0)
+				hive_nnue_add(values, feature);
+		}
+	}
+}
+
+void hive_nnue_refresh(Hive *hive)
+{
+	if (hive_nnue.map == NULL)
+		return;
+	for (int s = 0; s < 2; s++)
+		hive_nnue_compute(hive, s, hive->nnue.values[s]);
+}
+
+void hive_nnue_update(Hive *hive, const HivePiece *piece,
+		Point from, bool fromBoard, Point to, bool toBoard)
+{
+	if (hive_nnue.map == NULL)
+		return;
+	for (int s = 0; s < 2; s++) {
+		int16_t *const values = hive->nnue.values[s];
+		const Point queen = hive->eval.queens[s];
+		int feature;
+
+		/* everything is seen from somewhere else now */
+		if (piece->type == HIVE_QUEEN &&
+				piece->side == (enum hive_side) s) {
+			hive_nnue_compute(hive, s, values);
+			continue;
+		}
+		if (!hive->eval.hasQueen[s])
+			continue;
+		if (fromBoard && (feature = hive_nnue_feature(s, queen,
+						piece, from)) >= 0)
+			hive_nnue_subtract(values, feature);
+		if (toBoard && (feature = hive_nnue_feature(s, queen,
+						piece, to)) >= 0)
+			hive_nnue_add(values, feature);
+	}
+}
+
+/* the accumulators clipped to 0..127, the side to move first */
+static void hive_nnue_inputscalar(const Hive *hive, uint8_t *input)
+{
+	const int16_t *const sides[2] = {
+		hive->nnue.values[hive->turn],
+		hive->nnue.values[!hive->turn],
+	};
+
+	for (int s = 0; s < 2; s++)
+		for (size_t i = 0; i < HIVE_NNUE_HIDDEN; i++)
+			input[s * HIVE_NNUE_HIDDEN + i] =
+				MIN(MAX(sides[s][i], 0), 127);
+}
+
+static int hive_nnue_scalar(const Hive *hive)
+{
+	uint8_t input[2 * HIVE_NNUE_HIDDEN];
+	int32_t output = hive_nnue.outputBias;
+
+	hive_nnue_inputscalar(hive, input);
+	for (size_t o = 0; o < HIVE_NNUE_HIDDEN2; o++) {
+		const int8_t *const weights =
+			&hive_nnue.hiddenWeights[o * 2 * HIVE_NNUE_HIDDEN];
+		int32_t sum = hive_nnue.hiddenBias[o];
+
+		for (size_t i = 0; i < 2 * HIVE_NNUE_HIDDEN; i++)
+			sum += input[i] * weights[i];
+		output += MIN(MAX(sum >> HIVE_NNUE_SHIFT, 0), 127) *
+			hive_nnue.outputWeights[o];
+	}
+	return output / HIVE_NNUE_SCALE;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("ssse3")))
+static int32_t hive_nnue_hsum128(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4e));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+	return _mm_cvtsi128_si32(v);
+}
+
+/* unsigned bytes times signed bytes, summed into four int32 */
+__attribute__((target("ssse3")))
+static __m128i hive_nnue_dot128(__m128i sum, __m128i a, __m128i b)
+{
+	const __m128i products = _mm_maddubs_epi16(a, b);
+	return _mm_add_epi32(sum, _mm_madd_epi16(products,
+				_mm_set1_epi16(1)));
+}
+
+__attribute__((target("ssse3")))
+static int hive_nnue_ssse3(const Hive *hive)
+{
+	uint8_t input[2 * HIVE_NNUE_HIDDEN] __attribute__((aligned(16)));
+	uint8_t hidden[HIVE_NNUE_HIDDEN2] __attribute__((aligned(16)));
+	const int16_t *const sides[2] = {
+		hive->nnue.values[hive->turn],
+		hive->nnue.values[!hive->turn],
+	};
+	__m128i sum;
+
+	/* packing with unsigned saturation clips below 0 */
+	for (int s = 0; s < 2; s++)
+		for (size_t i = 0; i < HIVE_NNUE_HIDDEN; i += 16) {
+			const __m128i a = _mm_loadu_si128(
+					(const __m128i*) &sides[s][i]);
+			const __m128i b = _mm_loadu_si128(
+					(const __m128i*) &sides[s][i + 8]);
+			const __m128i packed = _mm_min_epu8(
+					_mm_packus_epi16(a, b),
+					_mm_set1_epi8(127));
+			_mm_store_si128((__m128i*)
+					&input[s * HIVE_NNUE_HIDDEN + i],
+					packed);
+		}
+
+	for (size_t o = 0; o < HIVE_NNUE_HIDDEN2; o++) {
+		const int8_t *const weights =
+			&hive_nnue.hiddenWeights[o * 2 * HIVE_NNUE_HIDDEN];
+		int32_t value;
+
+		sum = _mm_setzero_si128();
+		for (size_t i = 0; i < 2 * HIVE_NNUE_HIDDEN; i += 16)
+			sum = hive_nnue_dot128(sum,
+				_mm_load_si128((const __m128i*) &input[i]),
+				_mm_loadu_si128((const __m128i*) &weights[i]));
+		value = (hive_nnue_hsum128(sum) + hive_nnue.hiddenBias[o]) >>
+			HIVE_NNUE_SHIFT;
+		hidden[o] = MIN(MAX(value, 0), 127);
+	}
+
+	sum = _mm_setzero_si128();
+	for (size_t i = 0; i < HIVE_NNUE_HIDDEN2; i += 16)
+		sum = hive_nnue_dot128(sum,
+			_mm_load_si128((const __m128i*) &hidden[i]),
+			_mm_loadu_si128((const __m128i*)
+				&hive_nnue.outputWeights[i]));
+	return (hive_nnue_hsum128(sum) + hive_nnue.outputBias) /
+		HIVE_NNUE_SCALE;
+}
+
+__attribute__((target("avx2")))
+static int hive_nnue_avx2(const Hive *hive)
+{
+	uint8_t input[2 * HIVE_NNUE_HIDDEN] __attribute__((aligned(32)));
+	uint8_t hidden[HIVE_NNUE_HIDDEN2] __attribute__((aligned(32)));
+	const int16_t *const sides[2] = {
+		hive->nnue.values[hive->turn],
+		hive->nnue.values[!hive->turn],
+	};
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum;
+	__m128i half;
+
+	for (int s = 0; s < 2; s++)
+		for (size_t i = 0; i < HIVE_NNUE_HIDDEN; i += 32) {
+			const __m256i a = _mm256_loadu_si256(
+					(const __m256i*) &sides[s][i]);
+			const __m256i b = _mm256_loadu_si256(
+					(const __m256i*) &sides[s][i + 16]);
+			/* the pack works within each 128 bit lane, the
+			 * permute puts the quarters back in order
+			 */
+			const __m256i packed = _mm256_permute4x64_epi64(
+					_mm256_min_epu8(
+						_mm256_packus_epi16(a, b),
+						_mm256_set1_epi8(127)), 0xd8);
+			_mm256_store_si256((__m256i*)
+					&input[s * HIVE_NNUE_HIDDEN + i],
+					packed);
+		}
+
+	for (size_t o = 0; o < HIVE_NNUE_HIDDEN2; o++) {
+		const int8_t *const weights =
+			&hive_nnue.hiddenWeights[o * 2 * HIVE_NNUE_HIDDEN];
+		int32_t value;
+
+		sum = _mm256_setzero_si256();
+		for (size_t i = 0; i < 2 * HIVE_NNUE_HIDDEN; i += 32) {
+			const __m256i products = _mm256_maddubs_epi16(
+				_mm256_load_si256((const __m256i*) &input[i]),
+				_mm256_loadu_si256((const __m256i*)
+					&weights[i]));
+			sum = _mm256_add_epi32(sum,
+					_mm256_madd_epi16(products, ones));
+		}
+		half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+				_mm256_extracti128_si256(sum, 1));
+		value = (hive_nnue_hsum128(half) + hive_nnue.hiddenBias[o]) >>
+			HIVE_NNUE_SHIFT;
+		hidden[o] = MIN(MAX(value, 0), 127);
+	}
+
+	sum = _mm256_madd_epi16(_mm256_maddubs_epi16(
+			_mm256_load_si256((const __m256i*) hidden),
+			_mm256_loadu_si256((const __m256i*)
+				hive_nnue.outputWeights)), ones);
+	half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+			_mm256_extracti128_si256(sum, 1));
+	return (hive_nnue_hsum128(half) + hive_nnue.outputBias) /
+		HIVE_NNUE_SCALE;
+}
+
+#endif
+
+int hive_nnue_evaluate(const Hive *hive)
+{
+#ifndef NDEBUG
+	int16_t values[HIVE_NNUE_HIDDEN];
+
+	for (int s = 0; s < 2; s++) {
+		hive_nnue_compute(hive, s, values);
+		assert(memcmp(values, hive->nnue.values[s],
+					sizeof(values)) == 0);
+	}
+#endif
+	switch (hive_nnue.kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+	case HIVE_NNUE_AVX2:
+		return hive_nnue_avx2(hive);
+	case HIVE_NNUE_SSSE3:
+		return hive_nnue_ssse3(hive);
+#endif
+	default:
+		return hive_nnue_scalar(hive);
+	}
+}
@@ -1,30 +1,254 @@
 #include "hex.h"
 
-int hive_region_init(HiveRegion *region, int x, int y, int w, int h)
+void hive_region_clear(HiveRegion *region)
 {
-	WINDOW *win;
+	region->numPieces = 0;
+	memset(region->cells, 0, sizeof(region->cells));
+	memset(&region->masks, 0, sizeof(region->masks));
+	memset(&region->graph, 0, sizeof(region->graph));
+}
+
+static size_t hive_region_hash(Point at)
+{
+	uint32_t h;
+
+	/* fibonacci hashing, the upper bits of the product are the best
+	 * mixed ones
+	 */
+	h = ((uint32_t) at.x << 16 ^ (uint32_t) at.y) * 0x9e3779b1;
+	return h >> (32 - __builtin_ctz(HIVE_CELL_COUNT));
+}
+
+/* the slot of the cell at the given position, HIVE_CELL_COUNT if it is
+ * empty
+ */
+static size_t hive_region_findslot(const HiveRegion *region, Point at)
+{
+	for (size_t i = hive_region_hash(at);; i = (i + 1) &
+			(HIVE_CELL_COUNT - 1)) {
+		const HiveCell *const cell = &region->cells[i];
+		if (cell->count == 0)
+			return HIVE_CELL_COUNT;
+		if (point_isequal(cell->position, at))
+			return i;
+	}
+}
+
+static const HiveCell *hive_region_findcell(const HiveRegion *region,
+		Point at)
+{
+	const size_t i = hive_region_findslot(region, at);
+	return i == HIVE_CELL_COUNT ? NULL : &region->cells[i];
+}
+
+/* the same for changing the cell */
+static HiveCell *hive_region_getcell(HiveRegion *region, Point at)
+{
+	const size_t i = hive_region_findslot(region, at);
+	return i == HIVE_CELL_COUNT ? NULL : &region->cells[i];
+}
+
+/* adds a vertex for a newly occupied cell and connects it to the
+ * occupied cells around it
+ */
+static void hive_region_addvertex(HiveRegion *region, HiveCell *cell)
+{
+	uint64_t neighbors = 0;
+
+	for (int d = 0; d < 6; d++) {
+		const HiveCell *other;
+		Point p;
+
+		p = cell->position;
+		hive_movepoint(&p, d);
+		other = hive_region_findcell(region, p);
+		if (other != NULL)
+			neighbors |= (uint64_t) 1 << other->vertex;
+	}
+	cell->vertex = hive_graph_addvertex(&region->graph, neighbors);
+}
+
+/* puts the piece on top of the stack at its position, NULL if the stack
+ * is full
+ */
+static HiveCell *hive_region_stackcell(HiveRegion *region, HivePiece *piece,
+		bool *isNew)
+{
+	HiveCell *cell;
+
+	*isNew = false;
+	for (size_t i = hive_region_hash(piece->position);; i = (i + 1) &
+			(HIVE_CELL_COUNT - 1)) {
+		cell = &region->cells[i];
+		if (cell->count == 0) {
+			cell->position = piece->position;
+			*isNew = true;
+			break;
+		}
+		if (point_isequal(cell->position, piece->position))
+			break;
+	}
+	if (cell->count == HIVE_STACK_SIZE)
+		return NULL;
+	cell->stack[cell->count++] = piece;
+	return cell;
+}
+
+static void hive_region_indexpiece(HiveRegion *region, HivePiece *piece)
+{
+	HiveCell *cell;
+	bool isNew;
+
+	cell = hive_region_stackcell(region, piece, &isNew);
+	if (!region->hasGraph)
+		return;
+	if (isNew)
+		hive_region_addvertex(region, cell);
+	else
+		region->graph.stacked |= (uint64_t) 1 << cell->vertex;
+	hive_masks_update(&region->masks, region->cells, cell, cell->position);
+}
+
+/* linear probing with backward shift deletion, this keeps the probe
+ * sequences intact without needing tombstones
+ */
+static void hive_region_freecell(HiveRegion *region, HiveCell *cell)
+{
+	size_t i, j;
+
+	i = cell - region->cells;
+	j = i;
+	while (1) {
+		j = (j + 1) & (HIVE_CELL_COUNT - 1);
+		if (region->cells[j].count == 0)
+			break;
+		const size_t k = hive_region_hash(region->cells[j].position);
+		/* the entry at j can only be moved to i if i lies
+		 * cyclically between its home slot k and j
+		 */
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		region->cells[i] = region->cells[j];
+		i = j;
+	}
+	region->cells[i].count = 0;
+}
 
-	if ((win = newwin(h, w, y, x)) == NULL)
+static void hive_region_unindexpiece(HiveRegion *region, HivePiece *piece)
+{
+	HiveCell *cell;
+	uint32_t i;
+
+	cell = hive_region_getcell(region, piece->position);
+	if (cell == NULL)
+		/* should in theory never happen */
+		return;
+	if (--cell->count == 0) {
+		if (region->hasGraph)
+			hive_graph_removevertex(&region->graph, cell->vertex);
+		hive_region_freecell(region, cell);
+		if (region->hasGraph)
+			hive_masks_update(&region->masks, region->cells, NULL,
+					piece->position);
+		return;
+	}
+	if (cell->count == 1)
+		region->graph.stacked &= ~((uint64_t) 1 << cell->vertex);
+	/* usually the top piece leaves, otherwise close the gap */
+	for (i = 0; i < cell->count && cell->stack[i] != piece; i++)
+		(void) 0;
+	memmove(&cell->stack[i], &cell->stack[i + 1],
+		sizeof(*cell->stack) * (cell->count - i));
+	if (region->hasGraph)
+		hive_masks_update(&region->masks, region->cells, cell,
+				cell->position);
+}
+
+int hive_region_addpiece(HiveRegion *region, HivePiece *piece)
+{
+	return hive_region_insertpiece(region, region->numPieces, piece);
+}
+
+int hive_region_insertpiece(HiveRegion *region, size_t index,
+		HivePiece *piece)
+{
+	/* should in theory never happen */
+	if (region->numPieces == ARRLEN(region->pieces) ||
+			index > region->numPieces ||
+			hive_region_countat(region, piece->position) ==
+				HIVE_STACK_SIZE)
 		return -1;
-	memset(region, 0, sizeof(*region));
-	region->win = win;
+	memmove(&region->pieces[index + 1], &region->pieces[index],
+		sizeof(*region->pieces) * (region->numPieces - index));
+	region->pieces[index] = piece;
+	region->numPieces++;
+	hive_region_indexpiece(region, piece);
 	return 0;
 }
 
-int hive_region_addpiece(HiveRegion *region, HivePiece *piece)
+int hive_region_stackpiece(HiveRegion *region, HivePiece *piece)
 {
+	bool isNew;
+
 	/* should in theory never happen */
-	if (region->numPieces == ARRLEN(region->pieces))
+	if (region->numPieces == ARRLEN(region->pieces) ||
+			hive_region_stackcell(region, piece, &isNew) == NULL)
 		return -1;
 	region->pieces[region->numPieces++] = piece;
 	return 0;
 }
 
+void hive_region_reindex(HiveRegion *region)
+{
+	/* each pair of neighbors is found once, from the southern one */
+	static const int half[3] = {
+		HIVE_NORTH, HIVE_NORTH_EAST, HIVE_NORTH_WEST
+	};
+	HiveGraph *const graph = &region->graph;
+	uint32_t vertex = 0;
+
+	if (!region->hasGraph)
+		return;
+	memset(graph, 0, sizeof(*graph));
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		HiveCell *const cell = &region->cells[i];
+		if (cell->count == 0)
+			continue;
+		cell->vertex = vertex;
+		graph->vertices |= (uint64_t) 1 << vertex;
+		if (cell->count > 1)
+			graph->stacked |= (uint64_t) 1 << vertex;
+		vertex++;
+	}
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &region->cells[i];
+		if (cell->count == 0)
+			continue;
+		for (int d = 0; d < 3; d++) {
+			const HiveCell *other;
+			Point p;
+
+			p = cell->position;
+			hive_movepoint(&p, half[d]);
+			other = hive_region_findcell(region, p);
+			if (other == NULL)
+				continue;
+			graph->adjacent[cell->vertex] |=
+				(uint64_t) 1 << other->vertex;
+			graph->adjacent[other->vertex] |=
+				(uint64_t) 1 << cell->vertex;
+		}
+	}
+	hive_graph_recompute(graph);
+	hive_masks_rebuild(&region->masks, region->cells);
+}
+
 int hive_region_removepiece(HiveRegion *region, HivePiece *piece)
 {
 	for (size_t i = 0; i < region->numPieces; i++) {
 		if (region->pieces[i] != piece)
 			continue;
+		hive_region_unindexpiece(region, piece);
 		region->numPieces--;
 		memmove(&region->pieces[i], &region->pieces[i + 1],
 			sizeof(*region->pieces) * (region->numPieces - i));
@@ -34,61 +258,96 @@ int hive_region_removepiece(HiveRegion *region, HivePiece *piece)
 	return -1;
 }
 
+int hive_region_movepiece(HiveRegion *region, HivePiece *piece, Point to)
+{
+	/* should in theory never happen */
+	if (hive_region_countat(region, to) == HIVE_STACK_SIZE)
+		return -1;
+	hive_region_unindexpiece(region, piece);
+	piece->position = to;
+	hive_region_indexpiece(region, piece);
+	return 0;
+}
+
 void hive_region_clearflags(HiveRegion *region, uint64_t flags)
 {
 	for (size_t i = 0; i < region->numPieces; i++)
 		region->pieces[i]->flags &= ~flags;
 }
 
-HivePiece *hive_region_pieceatr(HiveRegion *region, HivePiece *from, Point at)
+/* the index of the piece in the stack of the cell */
+static int hive_region_levelof(const HiveCell *cell, const HivePiece *piece)
 {
-	bool doReturn;
+	for (int i = cell->count; i-- != 0; )
+		if (cell->stack[i] == piece)
+			return i;
+	return -1;
+}
 
-	doReturn = from == NULL;
-	for (size_t i = region->numPieces; i-- != 0; ) {
-		HivePiece *piece;
+HivePiece *hive_region_pieceatr(const HiveRegion *region,
+		const HivePiece *from, Point at)
+{
+	const HiveCell *cell;
+	int level;
+
+	cell = hive_region_findcell(region, at);
+	if (cell == NULL)
+		return NULL;
+	if (from == NULL)
+		return cell->stack[cell->count - 1];
+	level = hive_region_levelof(cell, from);
+	return level <= 0 ? NULL : cell->stack[level - 1];
+}
 
-		piece = region->pieces[i];
-		if (piece == from) {
-			doReturn = true;
-			continue;
-		}
-		if (doReturn && point_isequal(piece->position, at))
-			return piece;
-	}
-	return NULL;
+HivePiece *hive_region_pieceat(const HiveRegion *region,
+		const HivePiece *from, Point at)
+{
+	const HiveCell *cell;
+	int level;
+
+	cell = hive_region_findcell(region, at);
+	if (cell == NULL)
+		return NULL;
+	if (from == NULL)
+		return cell->stack[0];
+	level = hive_region_levelof(cell, from);
+	return level < 0 || (uint32_t) level + 1 == cell->count ? NULL :
+		cell->stack[level + 1];
 }
 
-HivePiece *hive_region_pieceat(HiveRegion *region, HivePiece *from, Point at)
+size_t hive_region_countat(const HiveRegion *region, Point at)
 {
-	bool doReturn;
+	const HiveCell *cell;
 
-	doReturn = from == NULL;
-	for (size_t i = 0; i < region->numPieces; i++) {
-		HivePiece *piece;
+	cell = hive_region_findcell(region, at);
+	return cell == NULL ? 0 : cell->count;
+}
 
-		piece = region->pieces[i];
-		if (piece == from) {
-			doReturn = true;
-			continue;
-		}
-		if (doReturn && point_isequal(piece->position, at))
-			return piece;
-	}
-	return NULL;
+int hive_region_vertexat(const HiveRegion *region, Point at)
+{
+	const HiveCell *cell;
+
+	cell = hive_region_findcell(region, at);
+	return cell == NULL ? -1 : (int) cell->vertex;
 }
 
-size_t hive_region_countat(HiveRegion *region, Point at)
+void hive_region_setvertex(HiveRegion *region, Point at, uint32_t vertex)
 {
-	size_t cnt = 0;
+	HiveCell *cell;
 
-	for (size_t i = 0; i < region->numPieces; i++)
-		if (point_isequal(region->pieces[i]->position, at))
-			cnt++;
-	return cnt;
+	cell = hive_region_getcell(region, at);
+	if (cell == NULL || cell->vertex == vertex)
+		return;
+	hive_graph_movevertex(&region->graph, cell->vertex, vertex);
+	cell->vertex = vertex;
 }
 
-size_t hive_region_getsurrounding(HiveRegion *region, Point at,
+const HiveCell *hive_region_cellat(const HiveRegion *region, Point at)
+{
+	return hive_region_findcell(region, at);
+}
+
+size_t hive_region_getsurrounding(const HiveRegion *region, Point at,
 		HivePiece *pieces[6])
 {
 	size_t num = 0;
@@ -103,7 +362,7 @@ size_t hive_region_getsurrounding(HiveRegion *region, Point at,
 	return num;
 }
 
-size_t hive_region_getsurroundingr(HiveRegion *region, Point at,
+size_t hive_region_getsurroundingr(const HiveRegion *region, Point at,
 		HivePiece *pieces[6])
 {
 	size_t num = 0;
@@ -135,132 +394,3 @@ uint32_t hive_region_count(HiveRegion *region, HivePiece *origin)
 	}
 	return cnt;
 }
-
-static const char *piece_names[] = {
-	[HIVE_ANT] = "A",
-	[HIVE_BEETLE] = "B",
-	[HIVE_GRASSHOPPER] = "G",
-	[HIVE_LADYBUG] = "L",
-	[HIVE_MOSQUITO] = "M",
-	[HIVE_PILLBUG] = "P",
-	[HIVE_QUEEN] = "Q",
-	[HIVE_SPIDER] = "S",
-};
-
-static const char *side_triangles[] = {
-	"\u25e2",
-	"\u25e3",
-	"\u25e4",
-	"\u25e5"
-};
-
-static const Point cell_offsets[] = {
-	{ 0, 0 },
-	{ 4, 0 },
-	{ 4, 1 },
-	{ 0, 1 }
-};
-
-void hive_region_renderhexat(HiveRegion *region, short fg, Point at)
-{
-	Point world;
-	HivePiece *pieces[6];
-
-	world = at;
-	hive_pointtoworld(&world, region->translation);
-	wattr_set(region->win, 0, COLOR(COLOR_BLACK, fg), NULL);
-	mvwaddstr(region->win, world.y, world.x + 1, "   ");
-	mvwaddstr(region->win, world.y + 1, world.x + 1, "   ");
-	hive_region_getsurroundingr(region, at, pieces);
-	for (int n = 0; n < 4; n++) {
-		short bg;
-		HivePiece *neighbor;
-
-		neighbor = n == 0 ? pieces[HIVE_NORTH_EAST] :
-			n == 1 ? pieces[HIVE_NORTH_WEST] :
-			n == 2 ? pieces[HIVE_SOUTH_WEST] :
-			pieces[HIVE_SOUTH_EAST];
-		bg = neighbor == NULL ? COLOR_BLACK :
-			(neighbor->flags & HIVE_SELECTED) ? COLOR_YELLOW :
-			(neighbor->flags & HIVE_ISACTOR) ? COLOR_GREEN :
-			neighbor->side == HIVE_WHITE ?  COLOR_BLUE : COLOR_RED;
-		wcolor_set(region->win, COLOR(fg, bg), NULL);
-		const Point off = cell_offsets[n];
-		mvwaddstr(region->win, world.y + off.y, world.x + off.x,
-				side_triangles[n]);
-	}
-}
-
-void hive_region_renderpieceat(HiveRegion *region, HivePiece *piece,
-		size_t cnt, Point at)
-{
-	short fg;
-
-	fg = piece->side == HIVE_WHITE ?  COLOR_BLUE : COLOR_RED;
-	wattr_set(region->win, 0, COLOR(COLOR_BLACK, fg), NULL);
-	mvwprintw(region->win, at.y, at.x + 1, " %s ",
-			piece_names[(int) piece->type]);
-	if (cnt > 1)
-		mvwprintw(region->win, at.y + 1, at.x + 1, " %zu ", cnt);
-	else
-		mvwaddstr(region->win, at.y + 1, at.x + 1, "   ");
-
-	for (int n = 0; n < 4; n++) {
-		wcolor_set(region->win, COLOR(fg, COLOR_YELLOW), NULL);
-		const Point off = cell_offsets[n];
-		mvwaddstr(region->win, at.y + off.y, at.x + off.x,
-				side_triangles[n]);
-	}
-}
-
-void hive_region_renderpiece(HiveRegion *region, HivePiece *piece)
-{
-	Point world;
-	HivePiece *pieces[6];
-	short fg, bg;
-
-	world = piece->position;
-	hive_pointtoworld(&world, region->translation);
-
-	fg = (piece->flags & HIVE_SELECTED) ? COLOR_YELLOW :
-		(piece->flags & HIVE_ISACTOR) ? COLOR_GREEN :
-		piece->side == HIVE_WHITE ?  COLOR_BLUE : COLOR_RED;
-	bg = (piece->flags & HIVE_IMMOBILE) ? COLOR_MAGENTA : COLOR_BLACK;
-	wattr_set(region->win, 0, COLOR(bg, fg), NULL);
-	mvwprintw(region->win, world.y, world.x + 1, " %s ",
-			piece_names[(int) piece->type]);
-	const size_t cnt = hive_region_countat(region, piece->position);
-	if (cnt > 1)
-		mvwprintw(region->win, world.y + 1, world.x + 1, " %zu ", cnt);
-	else
-		mvwaddstr(region->win, world.y + 1, world.x + 1, "   ");
-
-	hive_region_getsurroundingr(region, piece->position, pieces);
-	for (int n = 0; n < 4; n++) {
-		HivePiece *neighbor;
-
-		neighbor = n == 0 ? pieces[HIVE_NORTH_EAST] :
-			n == 1 ? pieces[HIVE_NORTH_WEST] :
-			n == 2 ? pieces[HIVE_SOUTH_WEST] :
-			pieces[HIVE_SOUTH_EAST];
-		bg = neighbor == NULL ? COLOR_BLACK :
-			(neighbor->flags & HIVE_SELECTED) ? COLOR_YELLOW :
-			(neighbor->flags & HIVE_ISACTOR) ? COLOR_GREEN :
-			neighbor->side == HIVE_WHITE ?  COLOR_BLUE : COLOR_RED;
-		wcolor_set(region->win, COLOR(fg, bg), NULL);
-		const Point off = cell_offsets[n];
-		mvwaddstr(region->win, world.y + off.y, world.x + off.x,
-				side_triangles[n]);
-	}
-}
-
-void hive_region_render(HiveRegion *region)
-{
-	werase(region->win);
-	for (size_t i = 0; i < region->numPieces; i++) {
-		HivePiece *const piece = region->pieces[i];
-		if (hive_region_getabove(region, piece) == NULL)
-			hive_region_renderpiece(region, piece);
-	}
-	wnoutrefresh(region->win);
-}
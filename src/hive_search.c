@@ -0,0 +1,391 @@
+#include "hex.h"
+
+/* how often the clock is looked at */
+#define HIVE_SEARCH_CHECK 1024
+
+static double hive_search_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int hive_search_init(HiveSearch *search, const Hive *hive, HiveTable *table)
+{
+	memset(search, 0, sizeof(*search));
+	if (hive_copy(&search->hive, hive) < 0)
+		return -1;
+	search->table = table;
+	return 0;
+}
+
+void hive_search_free(HiveSearch *search)
+{
+	for (size_t i = 0; i < ARRLEN(search->plies); i++) {
+		free(search->plies[i].moves.moves);
+		free(search->plies[i].scores);
+	}
+	hive_free(&search->hive);
+}
+
+static void hive_search_pass(Hive *hive)
+{
+	hive->turn = !hive->turn;
+	hive->hash ^= hive_hash_turn();
+}
+
+/* the table stores mate scores relative to the position, the search
+ * relative to the root
+ */
+static int hive_search_totable(int score, uint32_t ply)
+{
+	if (score >= HIVE_SCORE_MATE - HIVE_MAX_PLY)
+		return score + ply;
+	if (score <= -HIVE_SCORE_MATE + HIVE_MAX_PLY)
+		return score - ply;
+	return score;
+}
+
+static int hive_search_fromtable(int score, uint32_t ply)
+{
+	if (score >= HIVE_SCORE_MATE - HIVE_MAX_PLY)
+		return score - ply;
+	if (score <= -HIVE_SCORE_MATE + HIVE_MAX_PLY)
+		return score + ply;
+	return score;
+}
+
+static int32_t *hive_search_historyof(HiveSearch *search,
+		const HiveMove *move)
+{
+	return &search->history[search->hive.turn]
+		[(move->from.x & 7) << 3 | (move->from.y & 7)]
+		[(move->to.x & 7) << 3 | (move->to.y & 7)];
+}
+
+static int hive_search_scoremoves(HiveSearch *search,
+		struct hive_search_ply *ply, const HiveMove *tableMove)
+{
+	const HiveMoveList *const list = &ply->moves;
+
+	if (ply->numScores < list->count) {
+		int *const scores = realloc(ply->scores,
+				sizeof(*ply->scores) * list->capacity);
+		if (scores == NULL)
+			return -1;
+		ply->scores = scores;
+		ply->numScores = list->capacity;
+	}
+	for (size_t i = 0; i < list->count; i++) {
+		const HiveMove *const move = &list->moves[i];
+		if (tableMove != NULL && hive_move_isequal(move, tableMove))
+			ply->scores[i] = INT_MAX;
+		else if (hive_move_isequal(move, &ply->killers[0]))
+			ply->scores[i] = INT_MAX - 1;
+		else if (hive_move_isequal(move, &ply->killers[1]))
+			ply->scores[i] = INT_MAX - 2;
+		else
+			ply->scores[i] = *hive_search_historyof(search, move);
+	}
+	return 0;
+}
+
+/* swaps the best of the remaining moves to the front */
+static void hive_search_pickmove(struct hive_search_ply *ply, size_t from)
+{
+	HiveMove *const moves = ply->moves.moves;
+	size_t best = from;
+	HiveMove move;
+	int score;
+
+	for (size_t i = from + 1; i < ply->moves.count; i++)
+		if (ply->scores[i] > ply->scores[best])
+			best = i;
+	if (best == from)
+		return;
+	move = moves[from];
+	moves[from] = moves[best];
+	moves[best] = move;
+	score = ply->scores[from];
+	ply->scores[from] = ply->scores[best];
+	ply->scores[best] = score;
+}
+
+static void hive_search_addcutoff(HiveSearch *search,
+		struct hive_search_ply *ply, const HiveMove *move, int depth)
+{
+	int32_t *const history = hive_search_historyof(search, move);
+
+	if (!hive_move_isequal(move, &ply->killers[0])) {
+		ply->killers[1] = ply->killers[0];
+		ply->killers[0] = *move;
+	}
+	*history += depth * depth;
+	/* keep the values far below the killers */
+	if (*history > 1 << 20)
+		for (int s = 0; s < 2; s++)
+			for (int f = 0; f < 64; f++)
+				for (int t = 0; t < 64; t++)
+					search->history[s][f][t] /= 2;
+}
+
+static void hive_search_checklimits(HiveSearch *search)
+{
+	const HiveSearchLimits *const limits = &search->limits;
+
+	if (search->sharedStop != NULL &&
+			__atomic_load_n(search->sharedStop, __ATOMIC_RELAXED))
+		search->stop = true;
+	if (limits->nodes != 0 && search->nodes >= limits->nodes)
+		search->stop = true;
+	if (limits->seconds > 0 && search->nodes % HIVE_SEARCH_CHECK == 0 &&
+			hive_search_now() - search->start >= limits->seconds)
+		search->stop = true;
+}
+
+static int hive_search_negamax(HiveSearch *search, uint32_t depth,
+		uint32_t ply, int alpha, int beta)
+{
+	Hive *const hive = &search->hive;
+	struct hive_search_ply *const p = &search->plies[ply];
+	struct hive_search_ply *const next = &search->plies[ply + 1];
+	const bool isPv = beta - alpha > 1;
+	HiveTableData data;
+	const HiveMove *tableMove = NULL;
+	HiveUndo undo;
+	int best = -HIVE_SCORE_INFINITE;
+	HiveMove bestMove;
+	const int oldAlpha = alpha;
+	int score;
+
+	p->pvLength = 0;
+	search->nodes++;
+	hive_search_checklimits(search);
+	if (search->stop)
+		return 0;
+
+	const bool own = hive_issurrounded(hive, hive->turn);
+	const bool other = hive_issurrounded(hive, !hive->turn);
+	if (own && other)
+		return 0;
+	if (own)
+		return -HIVE_SCORE_MATE + ply;
+	if (other)
+		return HIVE_SCORE_MATE - ply;
+	if (depth == 0 || ply == HIVE_MAX_PLY)
+		return hive_evaluate(hive);
+
+	search->tableProbes++;
+	if (hive_table_probe(search->table, hive->hash, &data)) {
+		search->tableHits++;
+		score = hive_search_fromtable(data.score, ply);
+		if (!isPv && data.depth >= depth &&
+				(data.bound == HIVE_BOUND_EXACT ||
+				 (data.bound == HIVE_BOUND_LOWER &&
+				  score >= beta) ||
+				 (data.bound == HIVE_BOUND_UPPER &&
+				  score <= alpha)))
+			return score;
+		if (data.hasMove)
+			tableMove = &data.move;
+	}
+
+	hive_generatemoves(hive, NULL, &p->moves);
+	if (p->moves.count == 0) {
+		hive_search_pass(hive);
+		score = -hive_search_negamax(search, depth - 1, ply + 1,
+				-beta, -alpha);
+		hive_search_pass(hive);
+		return score;
+	}
+	if (hive_search_scoremoves(search, p, tableMove) < 0) {
+		search->stop = true;
+		return 0;
+	}
+
+	for (size_t i = 0; i < p->moves.count; i++) {
+		hive_search_pickmove(p, i);
+		const HiveMove *const move = &p->moves.moves[i];
+
+		hive_makemove(hive, move, &undo);
+		if (i == 0) {
+			score = -hive_search_negamax(search, depth - 1,
+					ply + 1, -beta, -alpha);
+		} else {
+			/* prove that the move is worse than the best so far
+			 * with a null window and only search it fully if
+			 * that fails
+			 */
+			score = -hive_search_negamax(search, depth - 1,
+					ply + 1, -alpha - 1, -alpha);
+			if (score > alpha && score < beta)
+				score = -hive_search_negamax(search, depth - 1,
+						ply + 1, -beta, -alpha);
+		}
+		hive_undomove(hive, &undo);
+		if (search->stop)
+			return 0;
+
+		if (score <= best)
+			continue;
+		best = score;
+		bestMove = *move;
+		if (score <= alpha)
+			continue;
+		alpha = score;
+		p->pv[0] = *move;
+		memcpy(&p->pv[1], next->pv, sizeof(*next->pv) * next->pvLength);
+		p->pvLength = next->pvLength + 1;
+		if (alpha >= beta) {
+			hive_search_addcutoff(search, p, move, depth);
+			break;
+		}
+	}
+
+	data.score = hive_search_totable(best, ply);
+	data.depth = depth;
+	data.bound = best >= beta ? HIVE_BOUND_LOWER :
+		best > oldAlpha ? HIVE_BOUND_EXACT : HIVE_BOUND_UPPER;
+	data.hasMove = true;
+	data.move = bestMove;
+	hive_table_store(search->table, hive->hash, &data);
+	return best;
+}
+
+void hive_search_run(HiveSearch *search, const HiveSearchLimits *limits,
+		HiveSearchResult *result)
+{
+	struct hive_search_ply *const root = &search->plies[0];
+	const uint32_t maxDepth = limits->depth == 0 ? HIVE_MAX_PLY :
+		MIN(limits->depth, (uint32_t) HIVE_MAX_PLY);
+	int score;
+
+	memset(result, 0, sizeof(*result));
+	search->limits = *limits;
+	search->start = hive_search_now();
+	search->nodes = 0;
+	search->tableProbes = 0;
+	search->tableHits = 0;
+	search->stop = false;
+	for (size_t i = 0; i < ARRLEN(search->plies); i++)
+		memset(search->plies[i].killers, 0,
+				sizeof(search->plies[i].killers));
+	memset(search->history, 0, sizeof(search->history));
+	/* the helpers are part of the search of the main thread */
+	if (search->id == 0)
+		hive_table_newsearch(search->table);
+
+	hive_generatemoves(&search->hive, NULL, &root->moves);
+	if (root->moves.count == 0)
+		return;
+	/* something to play even if not a single depth finishes */
+	result->hasMove = true;
+	result->move = root->moves.moves[0];
+
+	/* half of the helpers skip the first depth, so that the threads
+	 * are spread over two depths and fill the table for each other
+	 */
+	for (uint32_t depth = 1 + search->id % 2; depth <= maxDepth;
+			depth++) {
+		score = hive_search_negamax(search, depth, 0,
+				-HIVE_SCORE_INFINITE, HIVE_SCORE_INFINITE);
+		if (search->stop)
+			break;
+		result->score = score;
+		result->depth = depth;
+		if (root->pvLength > 0) {
+			result->move = root->pv[0];
+			memcpy(result->pv, root->pv,
+					sizeof(*root->pv) * root->pvLength);
+			result->pvLength = root->pvLength;
+		}
+		/* there is no point in looking deeper past a forced end */
+		if (abs(score) >= HIVE_SCORE_MATE - HIVE_MAX_PLY)
+			break;
+	}
+	result->nodes = search->nodes;
+	result->tableProbes = search->tableProbes;
+	result->tableHits = search->tableHits;
+	result->seconds = hive_search_now() - search->start;
+}
+
+struct hive_search_thread {
+	pthread_t thread;
+	bool isRunning;
+	HiveSearch search;
+	HiveSearchLimits limits;
+	HiveSearchResult result;
+};
+
+static void *hive_search_helper(void *arg)
+{
+	struct hive_search_thread *const t = arg;
+
+	hive_search_run(&t->search, &t->limits, &t->result);
+	return NULL;
+}
+
+int hive_search_parallel(const Hive *hive, HiveTable *table,
+		uint32_t numThreads, const HiveSearchLimits *limits,
+		HiveSearchResult *result)
+{
+	struct hive_search_thread *threads;
+	bool stop = false;
+	uint64_t nodes, probes, hits;
+	uint32_t best;
+	uint32_t numInit;
+
+	threads = calloc(MAX(numThreads, (uint32_t) 1), sizeof(*threads));
+	if (threads == NULL)
+		return -1;
+	for (numInit = 0; numInit < MAX(numThreads, (uint32_t) 1);
+			numInit++) {
+		struct hive_search_thread *const t = &threads[numInit];
+		if (hive_search_init(&t->search, hive, table) < 0)
+			break;
+		t->search.id = numInit;
+		t->search.sharedStop = &stop;
+		/* only the depth limits the helpers */
+		t->limits.depth = limits->depth;
+	}
+	if (numInit == 0) {
+		free(threads);
+		return -1;
+	}
+
+	/* a helper that can't be started is simply missing */
+	for (uint32_t i = 1; i < numInit; i++)
+		threads[i].isRunning = pthread_create(&threads[i].thread, NULL,
+				hive_search_helper, &threads[i]) == 0;
+	hive_search_run(&threads[0].search, limits, &threads[0].result);
+	__atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+	for (uint32_t i = 1; i < numInit; i++)
+		if (threads[i].isRunning)
+			pthread_join(threads[i].thread, NULL);
+
+	best = 0;
+	nodes = threads[0].result.nodes;
+	probes = threads[0].result.tableProbes;
+	hits = threads[0].result.tableHits;
+	for (uint32_t i = 1; i < numInit; i++) {
+		const HiveSearchResult *const r = &threads[i].result;
+		if (!threads[i].isRunning)
+			continue;
+		nodes += r->nodes;
+		probes += r->tableProbes;
+		hits += r->tableHits;
+		if (r->hasMove && r->pvLength > 0 &&
+				r->depth > threads[best].result.depth)
+			best = i;
+	}
+	*result = threads[best].result;
+	result->nodes = nodes;
+	result->tableProbes = probes;
+	result->tableHits = hits;
+	result->seconds = threads[0].result.seconds;
+	for (uint32_t i = 0; i < numInit; i++)
+		hive_search_free(&threads[i].search);
+	free(threads);
+	return 0;
+}
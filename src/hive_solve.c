@@ -0,0 +1,243 @@
+#include "hex.h"
+
+/* stands for proven or disproven, sums are cut off there */
+#define HIVE_SOLVER_INFINITE ((uint32_t) 1 << 30)
+#define HIVE_SOLVER_BUCKET 4
+
+int hive_solver_init(HiveSolver *solver, size_t megabytes)
+{
+	memset(solver, 0, sizeof(*solver));
+	solver->numEntries = HIVE_SOLVER_BUCKET;
+	while ((solver->numEntries << 1) * sizeof(*solver->entries) <=
+			megabytes << 20)
+		solver->numEntries <<= 1;
+	solver->entries = calloc(solver->numEntries,
+			sizeof(*solver->entries));
+	return solver->entries == NULL ? -1 : 0;
+}
+
+void hive_solver_free(HiveSolver *solver)
+{
+	for (size_t i = 0; i < ARRLEN(solver->plies); i++) {
+		free(solver->plies[i].moves.moves);
+		free(solver->plies[i].phi);
+		free(solver->plies[i].delta);
+	}
+	free(solver->entries);
+	solver->entries = NULL;
+}
+
+/* the same position is a different problem with fewer moves left */
+static uint64_t hive_solver_key(const Hive *hive, uint32_t remaining)
+{
+	return hive->hash ^ ((uint64_t) (remaining + 1) * 0x9e3779b97f4a7c15);
+}
+
+static HiveSolverEntry *hive_solver_bucketof(HiveSolver *solver,
+		uint64_t key)
+{
+	return &solver->entries[key & (solver->numEntries - 1) &
+		~(size_t) (HIVE_SOLVER_BUCKET - 1)];
+}
+
+static bool hive_solver_lookup(HiveSolver *solver, uint64_t key,
+		uint32_t *phi, uint32_t *delta)
+{
+	HiveSolverEntry *const bucket = hive_solver_bucketof(solver, key);
+
+	for (uint32_t i = 0; i < HIVE_SOLVER_BUCKET; i++)
+		if (bucket[i].key == key && bucket[i].work != 0) {
+			*phi = bucket[i].phi;
+			*delta = bucket[i].delta;
+			return true;
+		}
+	return false;
+}
+
+static void hive_solver_store(HiveSolver *solver, uint64_t key,
+		uint32_t phi, uint32_t delta, uint32_t work)
+{
+	HiveSolverEntry *const bucket = hive_solver_bucketof(solver, key);
+	HiveSolverEntry *victim = &bucket[0];
+
+	for (uint32_t i = 0; i < HIVE_SOLVER_BUCKET; i++) {
+		if (bucket[i].key == key) {
+			victim = &bucket[i];
+			work += bucket[i].work;
+			break;
+		}
+		if (bucket[i].work < victim->work)
+			victim = &bucket[i];
+	}
+	victim->key = key;
+	victim->phi = phi;
+	victim->delta = delta;
+	victim->work = MAX(work, (uint32_t) 1);
+}
+
+static void hive_solver_pass(Hive *hive)
+{
+	hive->turn = !hive->turn;
+	hive->hash ^= hive_hash_turn();
+}
+
+/* The numbers of a position without searching it, from the view of the
+ * side to move: phi is 0 if it has won and delta is 0 if it has lost.
+ * A draw or running out of moves counts as a loss for the attacker.
+ */
+static void hive_solver_leaf(HiveSolver *solver, uint32_t remaining,
+		uint32_t *phi, uint32_t *delta)
+{
+	Hive *const hive = &solver->hive;
+	const bool own = hive_isqueensurrounded(hive);
+	const bool other = hive_issurrounded(hive, !hive->turn);
+	bool hasWon;
+
+	if (own || other || remaining == 0) {
+		if (own != other)
+			hasWon = other;
+		else
+			hasWon = hive->turn != solver->attacker;
+		*phi = hasWon ? 0 : HIVE_SOLVER_INFINITE;
+		*delta = hasWon ? HIVE_SOLVER_INFINITE : 0;
+		return;
+	}
+	if (!hive_solver_lookup(solver, hive_solver_key(hive, remaining),
+				phi, delta)) {
+		*phi = 1;
+		*delta = 1;
+	}
+}
+
+static void hive_solver_play(Hive *hive, const HiveMoveList *moves,
+		size_t i, HiveUndo *undo)
+{
+	if (moves->count == 0)
+		hive_solver_pass(hive);
+	else
+		hive_makemove(hive, &moves->moves[i], undo);
+}
+
+static void hive_solver_unplay(Hive *hive, const HiveMoveList *moves,
+		const HiveUndo *undo)
+{
+	if (moves->count == 0)
+		hive_solver_pass(hive);
+	else
+		hive_undomove(hive, undo);
+}
+
+/* the numbers of the position are the smallest delta and the sum of all
+ * phi of the children, the child with the smallest delta is searched
+ * until the numbers reach their thresholds
+ */
+static void hive_solver_mid(HiveSolver *solver, uint32_t ply,
+		uint32_t remaining, uint32_t thPhi, uint32_t thDelta,
+		uint32_t *outPhi, uint32_t *outDelta)
+{
+	Hive *const hive = &solver->hive;
+	struct hive_solver_ply *const p = &solver->plies[ply];
+	const uint64_t key = hive_solver_key(hive, remaining);
+	const uint64_t startNodes = solver->nodes;
+	uint32_t phi, delta;
+	size_t count;
+	HiveUndo undo;
+
+	solver->nodes++;
+	hive_generatemoves(hive, NULL, &p->moves);
+	/* a side that can't move passes */
+	count = MAX(p->moves.count, (size_t) 1);
+	if (p->capacity < count) {
+		const size_t capacity = MAX(count, p->moves.capacity);
+		uint32_t *const newPhi = realloc(p->phi,
+				sizeof(*p->phi) * capacity);
+		uint32_t *const newDelta = realloc(p->delta,
+				sizeof(*p->delta) * capacity);
+		if (newPhi != NULL)
+			p->phi = newPhi;
+		if (newDelta != NULL)
+			p->delta = newDelta;
+		if (newPhi == NULL || newDelta == NULL) {
+			solver->maxNodes = solver->nodes;
+			*outPhi = 1;
+			*outDelta = 1;
+			return;
+		}
+		p->capacity = capacity;
+	}
+	for (size_t i = 0; i < count; i++) {
+		hive_solver_play(hive, &p->moves, i, &undo);
+		hive_solver_leaf(solver, remaining - 1, &p->phi[i], &p->delta[i]);
+		hive_solver_unplay(hive, &p->moves, &undo);
+	}
+
+	while (1) {
+		uint32_t delta2 = HIVE_SOLVER_INFINITE;
+		size_t best = 0;
+
+		phi = HIVE_SOLVER_INFINITE;
+		delta = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (p->delta[i] < phi) {
+				delta2 = phi;
+				phi = p->delta[i];
+				best = i;
+			} else if (p->delta[i] < delta2) {
+				delta2 = p->delta[i];
+			}
+			delta = MIN(delta + p->phi[i], HIVE_SOLVER_INFINITE);
+		}
+		if (phi >= thPhi || delta >= thDelta)
+			break;
+		if (solver->maxNodes != 0 && solver->nodes >= solver->maxNodes)
+			break;
+		hive_solver_play(hive, &p->moves, best, &undo);
+		hive_solver_mid(solver, ply + 1, remaining - 1,
+				thDelta - delta + p->phi[best],
+				MIN(thPhi, delta2 + 1),
+				&p->phi[best], &p->delta[best]);
+		hive_solver_unplay(hive, &p->moves, &undo);
+	}
+	hive_solver_store(solver, key, phi, delta,
+			MIN(solver->nodes - startNodes, (uint64_t) UINT32_MAX));
+	*outPhi = phi;
+	*outDelta = delta;
+}
+
+enum hive_proof hive_solve(HiveSolver *solver, const Hive *hive,
+		uint32_t moves, uint64_t maxNodes, HiveMove *move)
+{
+	struct hive_solver_ply *const root = &solver->plies[0];
+	const uint32_t remaining = 2 * MIN(moves, (uint32_t) HIVE_MAX_PLY) - 1;
+	enum hive_proof proof = HIVE_PROOF_UNKNOWN;
+	uint32_t phi, delta;
+
+	if (moves == 0)
+		return HIVE_PROOF_NOWIN;
+	if (hive_copy(&solver->hive, hive) < 0)
+		return HIVE_PROOF_UNKNOWN;
+	solver->attacker = hive->turn;
+	solver->nodes = 0;
+	solver->maxNodes = maxNodes;
+	memset(solver->entries, 0, sizeof(*solver->entries) *
+			solver->numEntries);
+	root->moves.count = 0;
+
+	hive_solver_leaf(solver, remaining, &phi, &delta);
+	if (phi != 0 && delta != 0)
+		hive_solver_mid(solver, 0, remaining, HIVE_SOLVER_INFINITE,
+				HIVE_SOLVER_INFINITE, &phi, &delta);
+	if (phi == 0) {
+		proof = HIVE_PROOF_WIN;
+		/* a position that is won already has no first move */
+		for (size_t i = 0; i < root->moves.count; i++)
+			if (root->delta[i] == 0) {
+				*move = root->moves.moves[i];
+				break;
+			}
+	} else if (delta == 0) {
+		proof = HIVE_PROOF_NOWIN;
+	}
+	hive_free(&solver->hive);
+	return proof;
+}
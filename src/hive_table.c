@@ -0,0 +1,236 @@
+#include "hex.h"
+
+/* layout of the packed data:
+ * bits 0-31 the move as four signed bytes (from.x, from.y, to.x, to.y)
+ * bits 32-47 the score
+ * bits 48-53 the depth
+ * bits 54-55 the bound
+ * bit 56 fromInventory, bit 57 isThrow, bit 58 hasMove
+ * bit 59 set for every stored entry, a zeroed entry is empty
+ * bits 60-63 the generation
+ */
+#define HIVE_TABLE_HASMOVE ((uint64_t) 1 << 58)
+#define HIVE_TABLE_USED ((uint64_t) 1 << 59)
+/* everything that belongs to the move */
+#define HIVE_TABLE_MOVE ((uint64_t) 0xffffffff | (uint64_t) 0x7 << 56)
+#define HIVE_TABLE_GENERATIONS 16
+
+static uint64_t hive_table_pack(const HiveTableData *data,
+		uint32_t generation)
+{
+	const HiveMove *const move = &data->move;
+	uint64_t packed;
+
+	assert(data->score >= INT16_MIN && data->score <= INT16_MAX);
+	packed = (uint64_t) (uint8_t) move->from.x |
+		(uint64_t) (uint8_t) move->from.y << 8 |
+		(uint64_t) (uint8_t) move->to.x << 16 |
+		(uint64_t) (uint8_t) move->to.y << 24;
+	packed |= (uint64_t) (uint16_t) data->score << 32;
+	packed |= (uint64_t) MIN(data->depth, (uint32_t) HIVE_TABLE_MAX_DEPTH) << 48;
+	packed |= (uint64_t) data->bound << 54;
+	packed |= (uint64_t) move->fromInventory << 56;
+	packed |= (uint64_t) move->isThrow << 57;
+	if (data->hasMove)
+		packed |= HIVE_TABLE_HASMOVE;
+	packed |= HIVE_TABLE_USED;
+	packed |= (uint64_t) (generation % HIVE_TABLE_GENERATIONS) << 60;
+	return packed;
+}
+
+static void hive_table_unpack(uint64_t packed, HiveTableData *data)
+{
+	HiveMove *const move = &data->move;
+
+	move->from.x = (int8_t) packed;
+	move->from.y = (int8_t) (packed >> 8);
+	move->to.x = (int8_t) (packed >> 16);
+	move->to.y = (int8_t) (packed >> 24);
+	data->score = (int16_t) (packed >> 32);
+	data->depth = (packed >> 48) & 0x3f;
+	data->bound = (packed >> 54) & 0x3;
+	move->fromInventory = (packed >> 56) & 1;
+	move->isThrow = (packed >> 57) & 1;
+	data->hasMove = (packed & HIVE_TABLE_HASMOVE) != 0;
+}
+
+static uint32_t hive_table_depthof(uint64_t packed)
+{
+	return (packed >> 48) & 0x3f;
+}
+
+/* how many searches ago the entry was stored */
+static uint32_t hive_table_ageof(const HiveTable *table, uint64_t packed)
+{
+	return (table->generation - (uint32_t) (packed >> 60)) %
+		HIVE_TABLE_GENERATIONS;
+}
+
+int hive_table_init(HiveTable *table, size_t megabytes, bool useHugePages)
+{
+	const size_t hugePage = 2 << 20;
+	size_t size;
+	void *mem = MAP_FAILED;
+
+	memset(table, 0, sizeof(*table));
+	table->numBuckets = 1;
+	while ((table->numBuckets << 1) * sizeof(HiveTableBucket) <=
+			megabytes << 20)
+		table->numBuckets <<= 1;
+	size = table->numBuckets * sizeof(HiveTableBucket);
+
+	if (useHugePages) {
+		size = (size + hugePage - 1) & ~(hugePage - 1);
+#ifdef MAP_HUGETLB
+		mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+				-1, 0);
+#endif
+		/* no reserved huge pages, let the kernel merge normal ones
+		 * if it can
+		 */
+		if (mem == MAP_FAILED) {
+			mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mem == MAP_FAILED)
+				return -1;
+#ifdef MADV_HUGEPAGE
+			madvise(mem, size, MADV_HUGEPAGE);
+#endif
+		}
+		table->isMapped = true;
+	} else {
+		mem = aligned_alloc(sizeof(HiveTableBucket), size);
+		if (mem == NULL)
+			return -1;
+		memset(mem, 0, size);
+	}
+	table->buckets = mem;
+	table->size = size;
+	return 0;
+}
+
+void hive_table_free(HiveTable *table)
+{
+	if (table->isMapped)
+		munmap(table->buckets, table->size);
+	else
+		free(table->buckets);
+	table->buckets = NULL;
+	table->numBuckets = 0;
+}
+
+void hive_table_clear(HiveTable *table)
+{
+	memset(table->buckets, 0, table->numBuckets *
+			sizeof(*table->buckets));
+	table->generation = 0;
+}
+
+void hive_table_newsearch(HiveTable *table)
+{
+	table->generation = (table->generation + 1) % HIVE_TABLE_GENERATIONS;
+}
+
+static HiveTableBucket *hive_table_bucketof(const HiveTable *table,
+		uint64_t key)
+{
+	return &table->buckets[key & (table->numBuckets - 1)];
+}
+
+/* both halves are read and written on their own, the check catches the
+ * case where the other half belongs to a different store
+ */
+static void hive_table_read(const HiveTableEntry *entry, uint64_t *check,
+		uint64_t *data)
+{
+	*check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+	*data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+}
+
+static void hive_table_write(HiveTableEntry *entry, uint64_t key,
+		uint64_t data)
+{
+	__atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+bool hive_table_probe(HiveTable *table, uint64_t key, HiveTableData *data)
+{
+	HiveTableBucket *const bucket = hive_table_bucketof(table, key);
+	uint64_t check, packed;
+
+	for (uint32_t i = 0; i < HIVE_BUCKET_SIZE; i++) {
+		hive_table_read(&bucket->entries[i], &check, &packed);
+		if (!(packed & HIVE_TABLE_USED) || (check ^ packed) != key)
+			continue;
+		hive_table_unpack(packed, data);
+		return true;
+	}
+	return false;
+}
+
+void hive_table_store(HiveTable *table, uint64_t key,
+		const HiveTableData *data)
+{
+	HiveTableBucket *const bucket = hive_table_bucketof(table, key);
+	HiveTableEntry *victim = NULL;
+	int victimValue = INT_MAX;
+	uint64_t check, packed;
+	uint64_t new;
+
+	new = hive_table_pack(data, table->generation);
+	for (uint32_t i = 0; i < HIVE_BUCKET_SIZE; i++) {
+		HiveTableEntry *const entry = &bucket->entries[i];
+		int value;
+
+		hive_table_read(entry, &check, &packed);
+		if (!(packed & HIVE_TABLE_USED)) {
+			if (victimValue > INT_MIN) {
+				victim = entry;
+				victimValue = INT_MIN;
+			}
+			continue;
+		}
+		if ((check ^ packed) == key) {
+			/* a shallower result of the same search is worth
+			 * less, unless it is exact
+			 */
+			if (data->bound != HIVE_BOUND_EXACT &&
+					hive_table_ageof(table, packed) == 0 &&
+					data->depth <
+					hive_table_depthof(packed))
+				return;
+			/* keep the best move of an earlier search */
+			if (!data->hasMove && (packed & HIVE_TABLE_HASMOVE))
+				new = (new & ~HIVE_TABLE_MOVE) |
+					(packed & HIVE_TABLE_MOVE);
+			hive_table_write(entry, key, new);
+			return;
+		}
+		value = (int) hive_table_depthof(packed) -
+			8 * (int) hive_table_ageof(table, packed);
+		if (value < victimValue) {
+			victim = entry;
+			victimValue = value;
+		}
+	}
+	hive_table_write(victim, key, new);
+}
+
+uint32_t hive_table_fill(const HiveTable *table)
+{
+	const size_t n = MIN(table->numBuckets, (size_t) 1000);
+	uint32_t used = 0;
+	uint64_t check, packed;
+
+	for (size_t b = 0; b < n; b++)
+		for (uint32_t i = 0; i < HIVE_BUCKET_SIZE; i++) {
+			hive_table_read(&table->buckets[b].entries[i],
+					&check, &packed);
+			if ((packed & HIVE_TABLE_USED) &&
+					hive_table_ageof(table, packed) == 0)
+				used++;
+		}
+	return used * 1000 / (n * HIVE_BUCKET_SIZE);
+}
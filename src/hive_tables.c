@@ -0,0 +1,45 @@
+#include "hex.h"
+
+const int hive_gates[6][2] = {
+	[HIVE_NORTH] = { HIVE_SOUTH_EAST, HIVE_SOUTH_WEST },
+	[HIVE_SOUTH] = { HIVE_NORTH_EAST, HIVE_NORTH_WEST },
+	[HIVE_NORTH_EAST] = { HIVE_SOUTH, HIVE_NORTH_WEST },
+	[HIVE_NORTH_WEST] = { HIVE_SOUTH, HIVE_NORTH_EAST },
+	[HIVE_SOUTH_EAST] = { HIVE_NORTH, HIVE_SOUTH_WEST },
+	[HIVE_SOUTH_WEST] = { HIVE_NORTH, HIVE_SOUTH_EAST },
+};
+
+uint8_t hive_slides[6][64];
+bool hive_climbs[HIVE_CLIMB_HEIGHTS][HIVE_CLIMB_HEIGHTS]
+	[HIVE_CLIMB_HEIGHTS][HIVE_CLIMB_HEIGHTS];
+
+/* the tables only depend on the rules, so they are filled before main() */
+__attribute__((constructor)) static void hive_inittables(void)
+{
+	for (int d = 0; d < 6; d++)
+		for (uint32_t m = 0; m < 64; m++) {
+			const bool front[2] = {
+				(m >> hive_gates[d][0]) & 1,
+				(m >> hive_gates[d][1]) & 1,
+			};
+			/* the only neighbor is the piece itself */
+			if (__builtin_popcount(m) == 1)
+				continue;
+			/* the piece can't pass through */
+			if (front[0] && front[1])
+				continue;
+			hive_slides[d][m] = HIVE_SLIDE_FREE;
+			if (front[0] || front[1])
+				hive_slides[d][m] |= HIVE_SLIDE_PIVOT;
+		}
+
+	/* a piece on top of the hive is blocked by a gate only if both
+	 * sides of it are higher than the cells it moves between
+	 */
+	for (uint32_t from = 0; from < HIVE_CLIMB_HEIGHTS; from++)
+		for (uint32_t to = 0; to < HIVE_CLIMB_HEIGHTS; to++)
+			for (uint32_t a = 0; a < HIVE_CLIMB_HEIGHTS; a++)
+				for (uint32_t b = 0; b < HIVE_CLIMB_HEIGHTS; b++)
+					hive_climbs[from][to][a][b] =
+						MAX(from, to) >= MIN(a, b);
+}
@@ -0,0 +1,466 @@
+#include "hex.h"
+
+static const char *piece_names[] = {
+	[HIVE_ANT] = "A",
+	[HIVE_BEETLE] = "B",
+	[HIVE_GRASSHOPPER] = "G",
+	[HIVE_LADYBUG] = "L",
+	[HIVE_MOSQUITO] = "M",
+	[HIVE_PILLBUG] = "P",
+	[HIVE_QUEEN] = "Q",
+	[HIVE_SPIDER] = "S",
+};
+
+static const char *side_triangles[] = {
+	"\u25e2",
+	"\u25e3",
+	"\u25e4",
+	"\u25e5"
+};
+
+static const Point cell_offsets[] = {
+	{ 0, 0 },
+	{ 4, 0 },
+	{ 4, 1 },
+	{ 0, 1 }
+};
+
+void hive_region_renderhexat(HiveRegion *region, short fg, Point at)
+{
+	Point world;
+	HivePiece *pieces[6];
+
+	world = at;
+	hive_pointtoworld(&world, region->translation);
+	wattr_set(region->win, 0, COLOR(COLOR_BLACK, fg), NULL);
+	mvwaddstr(region->win, world.y, world.x + 1, "   ");
+	mvwaddstr(region->win, world.y + 1, world.x + 1, "   ");
+	hive_region_getsurroundingr(region, at, pieces);
+	for (int n = 0; n < 4; n++) {
+		short bg;
+		HivePiece *neighbor;
+
+		neighbor = n == 0 ? pieces[HIVE_NORTH_EAST] :
+			n == 1 ? pieces[HIVE_NORTH_WEST] :
+			n == 2 ? pieces[HIVE_SOUTH_WEST] :
+			pieces[HIVE_SOUTH_EAST];
+		bg = neighbor == NULL ? COLOR_BLACK :
+			(neighbor->flags & HIVE_SELECTED) ? COLOR_YELLOW :
+			(neighbor->flags & HIVE_ISACTOR) ? COLOR_GREEN :
+			neighbor->side == HIVE_WHITE ?  COLOR_BLUE : COLOR_RED;
+		wcolor_set(region->win, COLOR(fg, bg), NULL);
+		const Point off = cell_offsets[n];
+		mvwaddstr(region->win, world.y + off.y, world.x + off.x,
+				side_triangles[n]);
+	}
+}
+
+void hive_region_renderpieceat(HiveRegion *region, HivePiece *piece,
+		size_t cnt, Point at)
+{
+	short fg;
+
+	fg = piece->side == HIVE_WHITE ?  COLOR_BLUE : COLOR_RED;
+	wattr_set(region->win, 0, COLOR(COLOR_BLACK, fg), NULL);
+	mvwprintw(region->win, at.y, at.x + 1, " %s ",
+			piece_names[(int) piece->type]);
+	if (cnt > 1)
+		mvwprintw(region->win, at.y + 1, at.x + 1, " %zu ", cnt);
+	else
+		mvwaddstr(region->win, at.y + 1, at.x + 1, "   ");
+
+	for (int n = 0; n < 4; n++) {
+		wcolor_set(region->win, COLOR(fg, COLOR_YELLOW), NULL);
+		const Point off = cell_offsets[n];
+		mvwaddstr(region->win, at.y + off.y, at.x + off.x,
+				side_triangles[n]);
+	}
+}
+
+void hive_region_renderpiece(HiveRegion *region, HivePiece *piece)
+{
+	Point world;
+	HivePiece *pieces[6];
+	short fg, bg;
+
+	world = piece->position;
+	hive_pointtoworld(&world, region->translation);
+
+	fg = (piece->flags & HIVE_SELECTED) ? COLOR_YELLOW :
+		(piece->flags & HIVE_ISACTOR) ? COLOR_GREEN :
+		piece->side == HIVE_WHITE ?  COLOR_BLUE : COLOR_RED;
+	bg = (piece->flags & HIVE_IMMOBILE) ? COLOR_MAGENTA : COLOR_BLACK;
+	wattr_set(region->win, 0, COLOR(bg, fg), NULL);
+	mvwprintw(region->win, world.y, world.x + 1, " %s ",
+			piece_names[(int) piece->type]);
+	const size_t cnt = hive_region_countat(region, piece->position);
+	if (cnt > 1)
+		mvwprintw(region->win, world.y + 1, world.x + 1, " %zu ", cnt);
+	else
+		mvwaddstr(region->win, world.y + 1, world.x + 1, "   ");
+
+	hive_region_getsurroundingr(region, piece->position, pieces);
+	for (int n = 0; n < 4; n++) {
+		HivePiece *neighbor;
+
+		neighbor = n == 0 ? pieces[HIVE_NORTH_EAST] :
+			n == 1 ? pieces[HIVE_NORTH_WEST] :
+			n == 2 ? pieces[HIVE_SOUTH_WEST] :
+			pieces[HIVE_SOUTH_EAST];
+		bg = neighbor == NULL ? COLOR_BLACK :
+			(neighbor->flags & HIVE_SELECTED) ? COLOR_YELLOW :
+			(neighbor->flags & HIVE_ISACTOR) ? COLOR_GREEN :
+			neighbor->side == HIVE_WHITE ?  COLOR_BLUE : COLOR_RED;
+		wcolor_set(region->win, COLOR(fg, bg), NULL);
+		const Point off = cell_offsets[n];
+		mvwaddstr(region->win, world.y + off.y, world.x + off.x,
+				side_triangles[n]);
+	}
+}
+
+void hive_region_render(HiveRegion *region)
+{
+	werase(region->win);
+	for (size_t i = 0; i < region->numPieces; i++) {
+		HivePiece *const piece = region->pieces[i];
+		if (hive_region_getabove(region, piece) == NULL)
+			hive_region_renderpiece(region, piece);
+	}
+	wnoutrefresh(region->win);
+}
+
+void hive_setposition(Hive *hive, int x, int y, int w, int h)
+{
+	Point cur;
+
+	delwin(hive->blackInventory.win);
+	delwin(hive->board.win);
+	delwin(hive->whiteInventory.win);
+	hive->blackInventory.win = newwin(h / 5, w, y + h - h / 5, x);
+	hive->whiteInventory.win = newwin(h / 5, w, y, x);
+	hive->board.win = newwin(h - 2 * (h / 5), w, y + h / 5, x);
+	cur = (Point) { w / 2, h / 4 };
+	hive_pointtogrid(&cur, hive->board.translation);
+	hive->hexCursor = cur;
+}
+
+void hive_computemoves(Hive *hive, enum hive_type type)
+{
+	HiveMoveList *const list = &hive->legalMoves;
+
+	point_list_clear(&hive->moves);
+	point_list_clear(&hive->choices);
+	if (type == HIVE_PILLBUG_CARRYING)
+		hive_generatethrows(hive, hive->actor, hive->selectedPiece,
+				list);
+	else
+		hive_generatepiecemoves(hive, &hive->cache,
+				hive->selectedPiece, type, list);
+	for (size_t i = 0; i < list->count; i++) {
+		const HiveMove *const move = &list->moves[i];
+		/* the pieces the selected piece can throw are choices */
+		if (move->isThrow && type != HIVE_PILLBUG_CARRYING) {
+			if (!point_list_contains(&hive->choices, move->from))
+				point_list_push(&hive->choices, move->from);
+		} else {
+			point_list_push(&hive->moves, move->to);
+		}
+	}
+}
+
+static void hive_computeplaces(Hive *hive)
+{
+	HiveMoveList *const list = &hive->legalMoves;
+
+	point_list_clear(&hive->moves);
+	point_list_clear(&hive->choices);
+	hive_generateplacements(hive, hive->selectedPiece, list);
+	for (size_t i = 0; i < list->count; i++)
+		point_list_push(&hive->moves, list->moves[i].to);
+}
+
+static void hive_selectpiece(Hive *hive, HiveRegion *region, HivePiece *piece)
+{
+	if (hive->actor != NULL) {
+		hive->actor->flags &= ~HIVE_ISACTOR;
+		hive->actor = NULL;
+	}
+	if (hive->selectedPiece != NULL) {
+		hive->selectedPiece->flags &= ~HIVE_SELECTED;
+		if (hive->selectedPiece == piece) {
+			hive->selectedPiece = NULL;
+			return;
+		}
+	}
+	if (piece == NULL || piece->side != hive->turn) {
+		hive->selectedPiece = NULL;
+		return;
+	}
+	hive->selectedRegion = region;
+	hive->selectedPiece = piece;
+	piece->flags |= HIVE_SELECTED;
+	if (piece->flags & HIVE_IMMOBILE) {
+		point_list_clear(&hive->moves);
+		point_list_clear(&hive->choices);
+		return;
+	}
+	if (region == &hive->board)
+		hive_computemoves(hive, piece->type);
+	else
+		hive_computeplaces(hive);
+}
+
+void hive_domove(Hive *hive, const HiveMove *move, bool doNotify)
+{
+	if (doNotify && hc_hasconnection(hive))
+		hc_notifymove(hive, move);
+	else
+		hive_playmove(hive, move);
+	hive_selectpiece(hive, NULL, NULL);
+}
+
+static bool hive_transferpiece(Hive *hive, HiveRegion *region, Point pos)
+{
+	HiveRegion *inventory;
+	HiveMove move;
+
+	if (hive->selectedPiece == NULL || region != &hive->board)
+		return false;
+	inventory = hive_getinventory(hive);
+	move.fromInventory = hive->selectedRegion == inventory;
+	move.isThrow = hive->actor != NULL;
+	move.from = hive->selectedPiece->position;
+	move.to = pos;
+	hive->selectedPiece->flags &= ~HIVE_SELECTED;
+	if (point_list_contains(&hive->moves, pos) ||
+			hive->board.numPieces == 0) {
+		hive_domove(hive, &move, true);
+		return true;
+	}
+	if (point_list_contains(&hive->choices, pos)) {
+		/* the selected pillbug (or mosquito next to one) carries
+		 * the chosen piece
+		 */
+		HivePiece *const piece =
+			hive_region_pieceatr(&hive->board, NULL, pos);
+		hive->actor = hive->selectedPiece;
+		hive->actor->flags |= HIVE_ISACTOR;
+		hive->selectedPiece = piece;
+		piece->flags |= HIVE_SELECTED;
+		hive_computemoves(hive, HIVE_PILLBUG_CARRYING);
+		return true;
+	}
+	return false;
+}
+
+static HiveRegion *hive_getregionat(Hive *hive, Point at)
+{
+	for (size_t i = 0; i < ARRLEN(hive->regions); i++) {
+		Point pos;
+
+		HiveRegion *const region = &hive->regions[i];
+		pos = at;
+		if (wmouse_trafo(region->win, &pos.y, &pos.x, false))
+			return region;
+	}
+	return NULL;
+}
+
+static void hive_pressposition(Hive *hive, HiveRegion *region, Point pos)
+{
+	HivePiece *piece;
+
+	if (!hive_transferpiece(hive, region, pos)) {
+		piece = hive_region_pieceatr(region, NULL, pos);
+		hive_selectpiece(hive, region, piece);
+	}
+}
+
+bool hive_handlemousepress(Hive *hive, int button, Point mouse)
+{
+	HiveRegion *region;
+	Point pos;
+
+	region = hive_getregionat(hive, mouse);
+	if (region == NULL) {
+		hive_selectpiece(hive, NULL, NULL);
+		return false;
+	}
+	pos = mouse;
+	wmouse_trafo(region->win, &pos.y, &pos.x, false);
+	hive_pointtogrid(&pos, region->translation);
+	switch (button) {
+	case 0:
+		hive_pressposition(hive, region, pos);
+		break;
+	}
+	return true;
+}
+
+static void hive_selectnexttype(Hive *hive, HiveRegion *region,
+		enum hive_type type)
+{
+	HivePiece *cur;
+	size_t i;
+
+	cur = hive->selectedPiece;
+	if (region != hive->selectedRegion)
+		cur = NULL;
+	if (cur != NULL) {
+		for (i = 0; i < region->numPieces; i++)
+			if (region->pieces[i] == cur)
+				break;
+		for (i++; i < region->numPieces; i++) {
+			HivePiece *const piece = region->pieces[i];
+			if (hive_region_getabove(region, piece) != NULL)
+				continue;
+			if (piece->side != hive->turn || piece->type != type)
+				continue;
+			hive_selectpiece(hive, region, piece);
+			return;
+		}
+	}
+
+	for (i = 0; i < region->numPieces; i++) {
+		HivePiece *const piece = region->pieces[i];
+		if (piece == cur)
+			break;
+		if (hive_region_getabove(region, piece) != NULL)
+			continue;
+		if (piece->side != hive->turn || piece->type != type)
+			continue;
+		hive_selectpiece(hive, region, piece);
+		break;
+	}
+}
+
+int hive_handle(Hive *hive, int c)
+{
+	static const struct {
+		char key;
+		enum hive_type type;
+	} keyTypeMap[] = {
+		{ 'a', HIVE_ANT },
+		{ 'b', HIVE_BEETLE },
+		{ 'g', HIVE_GRASSHOPPER },
+		{ 'l', HIVE_LADYBUG },
+		{ 'm', HIVE_MOSQUITO },
+		{ 'p', HIVE_PILLBUG },
+		{ 'q', HIVE_QUEEN },
+		{ 's', HIVE_SPIDER },
+	};
+	HiveRegion *region;
+
+	if (hive->selectedRegion == NULL)
+		hive->selectedRegion = &hive->board;
+	region = hive->selectedRegion;
+	switch (c) {
+	case '0':
+		if (hive->selectedPiece != NULL) {
+			hive->hexCursor.x = 0;
+			hive->hexCursor.y = 0;
+		} else {
+			region->translation.x = 0;
+			region->translation.y = 0;
+		}
+		break;
+	case KEY_LEFT:
+		if (hive->selectedPiece != NULL)
+			hive->hexCursor.x--;
+		else
+			region->translation.x--;
+		break;
+	case KEY_RIGHT:
+		if (hive->selectedPiece != NULL)
+			hive->hexCursor.x++;
+		else
+			region->translation.x++;
+		break;
+	case KEY_UP:
+		if (hive->selectedPiece != NULL)
+			hive->hexCursor.y--;
+		else
+			region->translation.y--;
+		break;
+	case KEY_DOWN:
+		if (hive->selectedPiece != NULL)
+			hive->hexCursor.y++;
+		else
+			region->translation.y++;
+		break;
+
+	case '\n':
+	case '\r':
+		if (hive->selectedPiece != NULL)
+			hive_pressposition(hive, &hive->board, hive->hexCursor);
+		break;
+
+	case 'a' ... 'z':
+	case 'A' ... 'Z':
+		for (size_t i = 0; i < ARRLEN(keyTypeMap); i++)
+			if (keyTypeMap[i].key == tolower(c)) {
+				hive_selectnexttype(hive,
+						islower(c) ? &hive->board :
+							hive_getinventory(hive),
+						keyTypeMap[i].type);
+				break;
+			}
+		break;
+
+	case KEY_BACKSPACE:
+	case '\b':
+	case 0x7f:
+		if (!hc_hasconnection(hive) && hive->undos.count > 0) {
+			hive_selectpiece(hive, NULL, NULL);
+			hive_takeback(hive);
+		}
+		break;
+
+	case 0x1b:
+		hive_selectpiece(hive, NULL, NULL);
+		break;
+	}
+	return 0;
+}
+
+void hive_render(Hive *hive)
+{
+	Point p;
+	size_t cnt;
+
+	for (size_t i = 0; i < ARRLEN(hive->regions); i++)
+		hive_region_render(&hive->regions[i]);
+	if (hive->selectedPiece == NULL)
+		return;
+	hive_region_renderhexat(&hive->board, COLOR_MAGENTA, hive->hexCursor);
+	wattr_set(hive->board.win, 0, COLOR(COLOR_BLACK, COLOR_YELLOW), NULL);
+	for (size_t i = 0; i < hive->moves.count; i++) {
+		p = hive->moves.points[i];
+		hive_pointtoworld(&p, hive->board.translation);
+		mvwaddstr(hive->board.win, p.y, p.x + 1, "   ");
+		mvwaddstr(hive->board.win, p.y + 1, p.x + 1, "   ");
+	}
+	wattr_set(hive->board.win, 0, COLOR(COLOR_BLACK, COLOR_GREEN), NULL);
+	for (size_t i = 0; i < hive->choices.count; i++) {
+		p = hive->choices.points[i];
+		hive_pointtoworld(&p, hive->board.translation);
+		mvwaddstr(hive->board.win, p.y, p.x + 1, "   ");
+		mvwaddstr(hive->board.win, p.y + 1, p.x + 1, "   ");
+	}
+	if (hive->selectedRegion != &hive->board) {
+		wnoutrefresh(hive->board.win);
+		return;
+	}
+	/* render the piece stack */
+	getmaxyx(hive->board.win, p.y, p.x);
+	p.y = 0;
+	p.x -= 7;
+	cnt = hive_region_countat(&hive->board, hive->selectedPiece->position);
+	for (HivePiece *piece = hive->selectedPiece; piece != NULL;
+			piece = hive_region_getbelow(&hive->board, piece)) {
+		hive_region_renderpieceat(&hive->board, piece, cnt, p);
+		cnt--;
+		p.y += 3;
+	}
+	wnoutrefresh(hive->board.win);
+}
@@ -0,0 +1,1297 @@
+#include "test.h"
+
+#include <time.h>
+
+HiveChat hive_chat;
+
+#define BENCH_POSITIONS 64
+
+static uint32_t bench_seed = 12345;
+
+static uint32_t bench_random(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return (bench_seed >> 16) & 0x7fff;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* moves all pieces from the inventories onto the board, each piece is put
+ * onto a random empty cell next to the already placed ones so that the
+ * result is one connected hive
+ */
+static void bench_fillboard(Hive *hive)
+{
+	PointList open;
+	Point pos;
+
+	memset(&open, 0, sizeof(open));
+	point_list_push(&open, (Point) { 0, 0 });
+	for (size_t i = 0; i < HIVE_PIECE_COUNT; i++) {
+		HivePiece *const piece = &hive->allPieces[i];
+		HiveRegion *const region = piece->side == HIVE_WHITE ?
+			&hive->whiteInventory : &hive->blackInventory;
+		const size_t f = bench_random() % open.count;
+		pos = open.points[f];
+		open.points[f] = open.points[--open.count];
+		hive_region_removepiece(region, piece);
+		piece->position = pos;
+		hive_region_addpiece(&hive->board, piece);
+		for (int d = 0; d < 6; d++) {
+			Point n;
+
+			n = pos;
+			hive_movepoint(&n, d);
+			if (hive_region_pieceat(&hive->board, NULL, n) != NULL ||
+					point_list_contains(&open, n))
+				continue;
+			point_list_push(&open, n);
+		}
+	}
+	free(open.points);
+	hive->hash = hive_computehash(hive);
+	hive_eval_compute(hive, &hive->eval);
+	hive_cache_clear(hive);
+}
+
+/* the side to move is part of the hash, a bench that changes it has to
+ * change the hash as well or all later benches work on wrong keys
+ */
+static void bench_setturn(Hive *hive, enum hive_side side)
+{
+	if (hive->turn != side)
+		hive->hash ^= hive_hash_turn();
+	hive->turn = side;
+}
+
+#ifndef NDEBUG
+static void bench_checkhashes(const Hive *hives, size_t n)
+{
+	for (size_t h = 0; h < n; h++)
+		assert(hives[h].hash == hive_computehash(&hives[h]));
+}
+#else
+#define bench_checkhashes(hives, n) ((void) 0)
+#endif
+
+static void bench_neighbors(Hive *hives, size_t n)
+{
+	const int rounds = 200;
+	size_t ops = 0, found = 0;
+	HivePiece *pieces[6];
+
+	bench_checkhashes(hives, n);
+	const double start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			HiveRegion *const board = &hives[h].board;
+			for (size_t i = 0; i < board->numPieces; i++) {
+				found += hive_region_getsurrounding(board,
+					board->pieces[i]->position, pieces);
+				found += hive_region_countat(board,
+					board->pieces[i]->position);
+				ops++;
+			}
+		}
+	const double elapsed = bench_now() - start;
+	printf("neighbors\t%10.1f ns/query\t(%zu)\n",
+			elapsed * 1e9 / ops, found);
+}
+
+/* what rendering and the beetle moves ask about each piece */
+static void bench_stacks(Hive *hives, size_t n)
+{
+	const int rounds = 200;
+	size_t ops = 0, found = 0;
+
+	bench_checkhashes(hives, n);
+	const double start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			HiveRegion *const board = &hives[h].board;
+			for (size_t i = 0; i < board->numPieces; i++) {
+				HivePiece *const piece = board->pieces[i];
+				found += hive_region_getabove(board, piece) != NULL;
+				found += hive_region_getbelow(board, piece) != NULL;
+				ops++;
+			}
+		}
+	const double elapsed = bench_now() - start;
+	printf("above/below\t%10.1f ns/piece\t(%zu)\n",
+			elapsed * 1e9 / ops, found);
+}
+
+static void bench_count(Hive *hives, size_t n)
+{
+	const int rounds = 200;
+	size_t ops = 0, found = 0;
+
+	bench_checkhashes(hives, n);
+	const double start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			HiveRegion *const board = &hives[h].board;
+			hive_region_clearflags(board, HIVE_VISITED);
+			found += hive_region_count(board, board->pieces[0]);
+			ops++;
+		}
+	const double elapsed = bench_now() - start;
+	printf("flood fill\t%10.1f ns/fill\t(%zu)\n",
+			elapsed * 1e9 / ops, found);
+}
+
+static void bench_movegen(Hive *hives, size_t n)
+{
+	const int rounds = 10;
+	size_t ops = 0, found = 0;
+
+	bench_checkhashes(hives, n);
+	const double start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			Hive *const hive = &hives[h];
+			for (size_t i = 0; i < HIVE_PIECE_COUNT; i++) {
+				HivePiece *const piece = &hive->allPieces[i];
+				if (hive_region_getabove(&hive->board, piece) != NULL)
+					continue;
+				bench_setturn(hive, piece->side);
+				hive->selectedPiece = piece;
+				hive_computemoves(hive, piece->type);
+				found += hive->moves.count + hive->choices.count;
+				ops++;
+			}
+			hive->selectedPiece = NULL;
+		}
+	const double elapsed = bench_now() - start;
+	printf("movegen\t\t%10.1f us/piece\t(%zu)\n",
+			elapsed * 1e6 / ops, found);
+}
+
+static void bench_generate(Hive *hives, size_t n)
+{
+	const int rounds = 10;
+	size_t ops = 0, found = 0;
+	HiveMoveList list;
+
+	bench_checkhashes(hives, n);
+	memset(&list, 0, sizeof(list));
+	const double start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++)
+			for (int s = 0; s < 2; s++) {
+				bench_setturn(&hives[h], s);
+				hive_generatemoves(&hives[h], &hives[h].cache,
+						&list);
+				found += list.count;
+				ops++;
+			}
+	const double elapsed = bench_now() - start;
+	printf("legal moves\t%10.1f us/position\t(%zu)\n",
+			elapsed * 1e6 / ops, found);
+	free(list.moves);
+}
+
+static void bench_makemove(Hive *hives, size_t n)
+{
+	const int rounds = 10;
+	size_t ops = 0;
+	HiveMoveList list;
+	HiveUndo undo;
+
+	bench_checkhashes(hives, n);
+	memset(&list, 0, sizeof(list));
+	double elapsed = 0;
+	for (size_t h = 0; h < n; h++)
+		for (int s = 0; s < 2; s++) {
+			bench_setturn(&hives[h], s);
+			hive_generatemoves(&hives[h], &hives[h].cache, &list);
+			const double start = bench_now();
+			for (int r = 0; r < rounds; r++)
+				for (size_t i = 0; i < list.count; i++) {
+					hive_makemove(&hives[h], &list.moves[i],
+							&undo);
+					hive_undomove(&hives[h], &undo);
+					ops++;
+				}
+			elapsed += bench_now() - start;
+		}
+	printf("make/undo\t%10.1f ns/move\t(%zu)\n",
+			elapsed * 1e9 / ops, ops);
+	free(list.moves);
+}
+
+/* the placement test as it is done cell by cell without bitboards */
+static size_t bench_placesscalar(Hive *hive, enum hive_side side)
+{
+	PointList places;
+	HivePiece *pieces[6];
+	Point pos;
+	size_t cnt;
+
+	memset(&places, 0, sizeof(places));
+	for (size_t i = 0; i < hive->board.numPieces; i++) {
+		HivePiece *const piece = hive->board.pieces[i];
+		if (piece->side != side)
+			continue;
+		for (int d = 0; d < 6; d++) {
+			bool affirm;
+
+			pos = piece->position;
+			hive_movepoint(&pos, d);
+			if (hive_region_pieceat(&hive->board, NULL, pos) != NULL ||
+					point_list_contains(&places, pos))
+				continue;
+			hive_region_getsurroundingr(&hive->board, pos, pieces);
+			affirm = true;
+			for (int n = 0; n < 6; n++)
+				if (pieces[n] != NULL && pieces[n]->side != side)
+					affirm = false;
+			if (affirm)
+				point_list_push(&places, pos);
+		}
+	}
+	cnt = places.count;
+	free(places.points);
+	return cnt;
+}
+
+static void bench_places(Hive *hives, size_t n)
+{
+	const int rounds = 200;
+	size_t ops = 0, scalar = 0, masked = 0;
+	HiveBitboard places;
+
+	bench_checkhashes(hives, n);
+	double start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++)
+			for (int s = 0; s < 2; s++) {
+				scalar += bench_placesscalar(&hives[h], s);
+				ops++;
+			}
+	const double scalarElapsed = bench_now() - start;
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++)
+			for (int s = 0; s < 2; s++) {
+				hive_masks_placements(&hives[h].board.masks, s,
+						&places);
+				masked += hive_bitboard_count(&places);
+			}
+	const double maskedElapsed = bench_now() - start;
+	printf("places scalar\t%10.1f ns/set\t(%zu)\n",
+			scalarElapsed * 1e9 / ops, scalar);
+	printf("places masks\t%10.1f ns/set\t(%zu)\n",
+			maskedElapsed * 1e9 / ops, masked);
+}
+
+static void bench_connected(Hive *hives, size_t n)
+{
+	const int rounds = 20;
+	size_t ops = 0, scalar = 0, masked = 0, movable = 0;
+
+	bench_checkhashes(hives, n);
+	double start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			HiveRegion *const board = &hives[h].board;
+			for (size_t i = 0; i < board->numPieces; i++) {
+				HivePiece *const piece = board->pieces[i];
+				HivePiece *pieces[6];
+				int d;
+
+				hive_region_clearflags(board, HIVE_VISITED);
+				piece->flags |= HIVE_VISITED;
+				hive_region_getsurrounding(board, piece->position,
+						pieces);
+				for (d = 0; pieces[d] == NULL; d++)
+					(void) 0;
+				scalar += hive_region_count(board, pieces[d]) ==
+					board->numPieces - 1;
+				ops++;
+			}
+		}
+	const double scalarElapsed = bench_now() - start;
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			HiveRegion *const board = &hives[h].board;
+			for (size_t i = 0; i < board->numPieces; i++)
+				masked += hive_masks_isconnectedwithout(
+					&board->masks,
+					board->pieces[i]->position);
+		}
+	const double maskedElapsed = bench_now() - start;
+
+	/* one articulation pass per position answers all pieces at once */
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			HiveRegion *const board = &hives[h].board;
+			const uint64_t pinned = hive_graph_pinned(&board->graph);
+			for (size_t i = 0; i < board->numPieces; i++) {
+				const int v = hive_region_vertexat(board,
+					board->pieces[i]->position);
+				movable += !(pinned & ((uint64_t) 1 << v));
+			}
+		}
+	const double graphElapsed = bench_now() - start;
+	printf("one hive scalar\t%10.1f ns/test\t(%zu)\n",
+			scalarElapsed * 1e9 / ops, scalar);
+	printf("one hive masks\t%10.1f ns/test\t(%zu)\n",
+			maskedElapsed * 1e9 / ops, masked);
+	printf("one hive graph\t%10.1f ns/test\t(%zu)\n",
+			graphElapsed * 1e9 / ops, movable);
+}
+
+/* the slide test as it is done with one lookup per cell and no tables,
+ * the piece comes from the cell opposite of dir
+ */
+static bool bench_slidescalar(const HiveRegion *board, Point pos, int dir)
+{
+	static const int gates[6][2] = {
+		[HIVE_NORTH] = { HIVE_SOUTH_EAST, HIVE_SOUTH_WEST },
+		[HIVE_SOUTH] = { HIVE_NORTH_EAST, HIVE_NORTH_WEST },
+		[HIVE_NORTH_EAST] = { HIVE_SOUTH, HIVE_NORTH_WEST },
+		[HIVE_NORTH_WEST] = { HIVE_SOUTH, HIVE_NORTH_EAST },
+		[HIVE_SOUTH_EAST] = { HIVE_NORTH, HIVE_SOUTH_WEST },
+		[HIVE_SOUTH_WEST] = { HIVE_NORTH, HIVE_SOUTH_EAST },
+	};
+	bool front[2];
+	size_t num;
+
+	if (hive_region_countat(board, pos) > 0)
+		return false;
+	/* the piece itself counts as neighbor */
+	num = 1;
+	for (int d = 0; d < 6; d++) {
+		Point p;
+
+		p = pos;
+		hive_movepoint(&p, d);
+		if (hive_region_countat(board, p) > 0)
+			num++;
+	}
+	if (num == 1)
+		return false;
+	for (int i = 0; i < 2; i++) {
+		Point p;
+
+		p = pos;
+		hive_movepoint(&p, gates[dir][i]);
+		front[i] = hive_region_countat(board, p) > 0;
+	}
+	if (front[0] && front[1])
+		return false;
+	return front[0] || front[1];
+}
+
+static bool bench_slidetable(const HiveRegion *board, Point pos, int dir)
+{
+	uint32_t mask;
+
+	if (hive_region_countat(board, pos) > 0)
+		return false;
+	if (!hive_masks_neighbors(&board->masks, pos, &mask))
+		return false;
+	mask |= 1 << hive_oppositedirection(dir);
+	return hive_slides[dir][mask] & HIVE_SLIDE_PIVOT;
+}
+
+/* the climb test of a piece on top of the given cell */
+static bool bench_climbscalar(const HiveRegion *board, Point from, int dir)
+{
+	static const int gates[6][2] = {
+		[HIVE_NORTH] = { HIVE_SOUTH_EAST, HIVE_SOUTH_WEST },
+		[HIVE_SOUTH] = { HIVE_NORTH_EAST, HIVE_NORTH_WEST },
+		[HIVE_NORTH_EAST] = { HIVE_SOUTH, HIVE_NORTH_WEST },
+		[HIVE_NORTH_WEST] = { HIVE_SOUTH, HIVE_NORTH_EAST },
+		[HIVE_SOUTH_EAST] = { HIVE_NORTH, HIVE_SOUTH_WEST },
+		[HIVE_SOUTH_WEST] = { HIVE_NORTH, HIVE_SOUTH_EAST },
+	};
+	size_t cnts[3], cnt, num;
+	Point pos;
+
+	pos = from;
+	hive_movepoint(&pos, dir);
+	cnt = hive_region_countat(board, from);
+	num = 0;
+	for (int d = 0; d < 6; d++) {
+		Point p;
+
+		p = pos;
+		hive_movepoint(&p, d);
+		if (hive_region_countat(board, p) > 0)
+			num++;
+	}
+	if (num == 1 && cnt == 1)
+		return false;
+	cnts[1] = hive_region_countat(board, pos);
+	for (int i = 0; i < 2; i++) {
+		Point p;
+
+		p = pos;
+		hive_movepoint(&p, gates[dir][i]);
+		cnts[i * 2] = hive_region_countat(board, p);
+	}
+	return MAX(cnts[1], cnt) >= MIN(cnts[0], cnts[2]);
+}
+
+static bool bench_climbtable(const HiveRegion *board, Point from, int dir)
+{
+	size_t heights[4];
+	uint32_t mask;
+	Point pos;
+
+	pos = from;
+	hive_movepoint(&pos, dir);
+	heights[0] = hive_region_countat(board, from);
+	if (!hive_masks_neighbors(&board->masks, pos, &mask))
+		return false;
+	if (__builtin_popcount(mask) == 1 && heights[0] == 1)
+		return false;
+	heights[1] = hive_region_countat(board, pos);
+	for (int i = 0; i < 2; i++) {
+		Point p;
+
+		heights[2 + i] = 0;
+		if (!(mask & (1 << hive_gates[dir][i])))
+			continue;
+		p = pos;
+		hive_movepoint(&p, hive_gates[dir][i]);
+		heights[2 + i] = hive_region_countat(board, p);
+	}
+	return hive_climbs[hive_climbheight(heights[0])]
+		[hive_climbheight(heights[1])]
+		[hive_climbheight(heights[2])]
+		[hive_climbheight(heights[3])];
+}
+
+/* every slide from the cells around the hive and every climb from the
+ * occupied cells, once with lookups per cell and once with the tables
+ */
+static void bench_tables(Hive *hives, size_t n)
+{
+	const int rounds = 50;
+	size_t ops[2] = { 0, 0 };
+	size_t found[4] = { 0, 0, 0, 0 };
+	double elapsed[4];
+	PointList *perimeters;
+	HiveBitboard cells;
+
+	bench_checkhashes(hives, n);
+	/* the corpus: the empty cells around each hive */
+	perimeters = calloc(n, sizeof(*perimeters));
+	for (size_t h = 0; h < n; h++) {
+		const HiveMasks *const masks = &hives[h].board.masks;
+		hive_bitboard_neighbors(&masks->heights[0], &cells);
+		for (size_t i = 0; i < HIVE_BITBOARD_WORDS; i++)
+			cells.words[i] &= ~masks->heights[0].words[i];
+		hive_masks_topoints(masks, &cells, &perimeters[h]);
+		ops[0] += perimeters[h].count * 6 * rounds;
+		ops[1] += hives[h].board.numPieces * 6 * rounds;
+	}
+
+	for (int t = 0; t < 4; t++) {
+		bool (*const slide)(const HiveRegion*, Point, int) =
+			t == 0 ? bench_slidescalar : bench_slidetable;
+		bool (*const climb)(const HiveRegion*, Point, int) =
+			t == 2 ? bench_climbscalar : bench_climbtable;
+
+		const double start = bench_now();
+		for (int r = 0; r < rounds; r++)
+			for (size_t h = 0; h < n; h++) {
+				const HiveRegion *const board = &hives[h].board;
+				if (t < 2) {
+					for (size_t i = 0; i < perimeters[h].count; i++)
+						for (int d = 0; d < 6; d++)
+							found[t] += slide(board,
+								perimeters[h].points[i], d);
+					continue;
+				}
+				for (size_t i = 0; i < board->numPieces; i++)
+					for (int d = 0; d < 6; d++)
+						found[t] += climb(board,
+							board->pieces[i]->position, d);
+			}
+		elapsed[t] = bench_now() - start;
+	}
+	printf("slide scalar\t%10.1f ns/test\t(%zu)\n",
+			elapsed[0] * 1e9 / ops[0], found[0]);
+	printf("slide table\t%10.1f ns/test\t(%zu)\n",
+			elapsed[1] * 1e9 / ops[0], found[1]);
+	printf("climb scalar\t%10.1f ns/test\t(%zu)\n",
+			elapsed[2] * 1e9 / ops[1], found[2]);
+	printf("climb table\t%10.1f ns/test\t(%zu)\n",
+			elapsed[3] * 1e9 / ops[1], found[3]);
+	for (size_t h = 0; h < n; h++)
+		free(perimeters[h].points);
+	free(perimeters);
+}
+
+/* takes every piece that is free to move off the board and puts it back,
+ * once keeping the blocks up to date and once finding them from scratch
+ */
+static void bench_graph(Hive *hives, size_t n)
+{
+	const int rounds = 200;
+	size_t ops = 0, incremental = 0, full = 0;
+	HiveGraph graph;
+
+	bench_checkhashes(hives, n);
+	double start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			graph = hives[h].board.graph;
+			for (uint64_t m = graph.vertices & ~hive_graph_pinned(&graph);
+					m != 0; m &= m - 1) {
+				const uint32_t v = __builtin_ctzll(m);
+				const uint64_t neighbors = graph.adjacent[v];
+				hive_graph_removevertex(&graph, v);
+				hive_graph_addvertex(&graph, neighbors);
+				incremental += __builtin_popcountll(graph.cuts);
+				ops++;
+			}
+		}
+	const double incrementalElapsed = bench_now() - start;
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			graph = hives[h].board.graph;
+			for (uint64_t m = graph.vertices & ~hive_graph_pinned(&graph);
+					m != 0; m &= m - 1) {
+				const uint32_t v = __builtin_ctzll(m);
+				const uint64_t bit = (uint64_t) 1 << v;
+				graph.vertices &= ~bit;
+				hive_graph_recompute(&graph);
+				graph.vertices |= bit;
+				hive_graph_recompute(&graph);
+				full += __builtin_popcountll(graph.cuts);
+			}
+		}
+	const double fullElapsed = bench_now() - start;
+	printf("blocks update\t%10.1f ns/move\t(%zu)\n",
+			incrementalElapsed * 1e9 / ops, incremental);
+	printf("blocks full\t%10.1f ns/move\t(%zu)\n",
+			fullElapsed * 1e9 / ops, full);
+}
+
+/* probes and stores the positions two moves away twice, like an iterative
+ * deepening search would; the second pass should mostly hit
+ */
+static void bench_table(Hive *hives, size_t n)
+{
+	const int rounds = 2;
+	size_t ops = 0, hits = 0;
+	HiveTable table;
+	HiveTableData data;
+	HiveMoveList first, second;
+	HiveUndo undo1, undo2;
+
+	bench_checkhashes(hives, n);
+	if (hive_table_init(&table, 16, true) < 0) {
+		printf("table\t\tno memory\n");
+		return;
+	}
+	memset(&first, 0, sizeof(first));
+	memset(&second, 0, sizeof(second));
+	memset(&data, 0, sizeof(data));
+	double elapsed = 0;
+	for (int r = 0; r < rounds; r++) {
+		hive_table_newsearch(&table);
+		for (size_t h = 0; h < n; h++) {
+			Hive *const hive = &hives[h];
+
+			hive_generatemoves(hive, &hive->cache, &first);
+			for (size_t i = 0; i < first.count; i++) {
+				hive_makemove(hive, &first.moves[i], &undo1);
+				hive_generatemoves(hive, &hive->cache, &second);
+				const double start = bench_now();
+				for (size_t j = 0; j < second.count; j++) {
+					hive_makemove(hive, &second.moves[j],
+							&undo2);
+					if (hive_table_probe(&table, hive->hash,
+								&data)) {
+						hits++;
+					} else {
+						data.depth = r;
+						data.bound = HIVE_BOUND_EXACT;
+						data.hasMove = true;
+						data.move = second.moves[j];
+						hive_table_store(&table,
+							hive->hash, &data);
+					}
+					hive_undomove(hive, &undo2);
+					ops++;
+				}
+				elapsed += bench_now() - start;
+				hive_undomove(hive, &undo1);
+			}
+		}
+	}
+	printf("table\t\t%10.1f ns/node\t(%zu)\n", elapsed * 1e9 / ops, ops);
+	printf("table hits\t%10.1f %%\n", 100.0 * hits / ops);
+	printf("table fill\t%10u permill\n", hive_table_fill(&table));
+	hive_table_free(&table);
+	free(first.moves);
+	free(second.moves);
+}
+
+/* searches with a node limit twice, the two runs must agree */
+static void bench_search(Hive *hives, size_t n)
+{
+	static HiveSearch search;
+	const HiveSearchLimits limits = { .nodes = 20000 };
+	HiveTable table;
+	HiveSearchResult result, again;
+	size_t nodes = 0, depths = 0, mismatches = 0;
+	double elapsed = 0;
+
+	bench_checkhashes(hives, n);
+	if (hive_table_init(&table, 16, false) < 0) {
+		printf("search\t\tno memory\n");
+		return;
+	}
+	n = MIN(n, (size_t) 16);
+	for (size_t h = 0; h < n; h++) {
+		if (hive_search_init(&search, &hives[h], &table) < 0)
+			break;
+		hive_table_clear(&table);
+		hive_search_run(&search, &limits, &result);
+		hive_table_clear(&table);
+		hive_search_run(&search, &limits, &again);
+		if (!hive_move_isequal(&result.move, &again.move) ||
+				result.score != again.score ||
+				result.nodes != again.nodes)
+			mismatches++;
+		nodes += result.nodes;
+		depths += result.depth;
+		elapsed += result.seconds;
+		hive_search_free(&search);
+	}
+	printf("search\t\t%10.1f us/node\t(%zu)\n", elapsed * 1e6 / nodes,
+			nodes);
+	printf("search depth\t%10.1f\t\t(%zu different)\n",
+			(double) depths / n, mismatches);
+	hive_table_free(&table);
+}
+
+/* time to reach a fixed depth with more and more threads */
+static void bench_smp(Hive *hives, size_t n)
+{
+	static const uint32_t threads[] = { 1, 2, 4, 8, 16 };
+	const HiveSearchLimits limits = { .depth = 4 };
+	HiveTable table;
+	HiveSearchResult result;
+	double base = 0;
+
+	bench_checkhashes(hives, n);
+	if (hive_table_init(&table, 64, true) < 0) {
+		printf("smp\t\tno memory\n");
+		return;
+	}
+	n = MIN(n, (size_t) 4);
+	for (size_t t = 0; t < ARRLEN(threads); t++) {
+		size_t nodes = 0, probes = 0, hits = 0;
+		double elapsed = 0;
+
+		for (size_t h = 0; h < n; h++) {
+			hive_table_clear(&table);
+			const double start = bench_now();
+			if (hive_search_parallel(&hives[h], &table, threads[t],
+						&limits, &result) < 0)
+				break;
+			elapsed += bench_now() - start;
+			nodes += result.nodes;
+			probes += result.tableProbes;
+			hits += result.tableHits;
+		}
+		if (t == 0)
+			base = elapsed;
+		printf("smp %2u threads\t%10.3f s\t\t(%zu) %.2fx, %.1f %% hits\n",
+				threads[t], elapsed, nodes, base / elapsed,
+				probes == 0 ? 0 : 100.0 * hits / probes);
+	}
+	hive_table_free(&table);
+}
+
+static void bench_mcts(Hive *hives, size_t n)
+{
+	static const uint32_t threads[] = { 1, 4 };
+	const HiveMctsLimits limits = { .playouts = 500 };
+	HiveMcts mcts;
+	HiveMctsResult result;
+
+	bench_checkhashes(hives, n);
+	if (hive_mcts_init(&mcts, 64) < 0) {
+		printf("mcts\t\tno memory\n");
+		return;
+	}
+	n = MIN(n, (size_t) 4);
+	for (size_t t = 0; t < ARRLEN(threads); t++) {
+		size_t playouts = 0, nodes = 0;
+		double elapsed = 0;
+
+		for (size_t h = 0; h < n; h++) {
+			if (hive_mcts_run(&mcts, &hives[h], threads[t], &limits,
+						&result) < 0)
+				break;
+			playouts += result.playouts;
+			nodes += result.numNodes;
+			elapsed += result.seconds;
+		}
+		printf("mcts %u threads\t%10.0f playouts/s\t(%zu nodes)\n",
+				threads[t], playouts / elapsed, nodes);
+	}
+	printf("mcts node\t%10zu bytes\n", sizeof(HiveMctsNode));
+	hive_mcts_free(&mcts);
+}
+
+/* evaluates the positions after each move, once with the terms kept by
+ * hive_makemove and once computing them from scratch
+ */
+static void bench_eval(Hive *hives, size_t n)
+{
+	const int rounds = 20;
+	HiveMoveList list;
+	HiveUndo undo;
+	size_t ops = 0, mismatches = 0;
+	double incremental = 0, full = 0;
+	volatile int sink = 0;
+
+	bench_checkhashes(hives, n);
+	memset(&list, 0, sizeof(list));
+	for (size_t h = 0; h < n; h++) {
+		hive_generatemoves(&hives[h], &hives[h].cache, &list);
+		for (size_t i = 0; i < list.count; i++) {
+			hive_makemove(&hives[h], &list.moves[i], &undo);
+			if (hive_evaluate(&hives[h]) !=
+					hive_evaluate_full(&hives[h]))
+				mismatches++;
+			double start = bench_now();
+			for (int r = 0; r < rounds; r++)
+				sink += hive_evaluate(&hives[h]);
+			incremental += bench_now() - start;
+			start = bench_now();
+			for (int r = 0; r < rounds; r++)
+				sink += hive_evaluate_full(&hives[h]);
+			full += bench_now() - start;
+			hive_undomove(&hives[h], &undo);
+			ops += rounds;
+		}
+	}
+	printf("eval\t\t%10.0f evals/s\t(%zu different)\n",
+			ops / incremental, mismatches);
+	printf("eval full\t%10.0f evals/s\n", ops / full);
+	free(list.moves);
+}
+
+#define BENCH_CACHE_TURNS 40
+
+/* a turn of a game in the UI: hive_playmove generates all moves to see if
+ * the side to move can move at all, then each selected piece generates
+ * its own moves again
+ */
+static size_t bench_cacheturn(Hive *hive, HiveMoveList *list, bool useCache)
+{
+	HiveMoveCache *const cache = useCache ? &hive->cache : NULL;
+	size_t found;
+
+	hive_generatemoves(hive, cache, list);
+	found = list->count;
+	for (size_t i = 0; i < hive->board.numPieces; i++) {
+		const HivePiece *const piece = hive->board.pieces[i];
+		if (piece->side != hive->turn)
+			continue;
+		hive_generatepiecemoves(hive, cache, piece, piece->type, list);
+		found += list->count;
+	}
+	return found;
+}
+
+/* replays random games turn by turn, the verify run also tries a few
+ * other moves first and takes each one back, those leave the entries of
+ * undone moves behind
+ */
+static void bench_cache(size_t n)
+{
+	static Hive game;
+	static HiveMove played[64][BENCH_CACHE_TURNS];
+	size_t numPlayed[64];
+	HiveMoveList list, tries;
+	HiveUndo undo;
+	size_t turns = 0, found[2] = { 0, 0 };
+	double elapsed[2];
+	HiveMoveCache *const cache = &game.cache;
+
+	n = MIN(n, ARRLEN(played));
+	memset(&list, 0, sizeof(list));
+	memset(&tries, 0, sizeof(tries));
+	for (size_t h = 0; h < n; h++) {
+		hive_init(&game);
+		for (numPlayed[h] = 0; numPlayed[h] < BENCH_CACHE_TURNS;
+				numPlayed[h]++) {
+			hive_generatemoves(&game, NULL, &list);
+			if (list.count == 0 ||
+					hive_getresult(&game) != HIVE_ONGOING)
+				break;
+			played[h][numPlayed[h]] =
+				list.moves[bench_random() % list.count];
+			hive_makemove(&game, &played[h][numPlayed[h]], &undo);
+		}
+		turns += numPlayed[h];
+		hive_free(&game);
+	}
+	for (int c = 0; c < 2; c++) {
+		const double start = bench_now();
+		for (size_t h = 0; h < n; h++) {
+			hive_init(&game);
+			for (size_t m = 0; m < numPlayed[h]; m++) {
+				found[c] += bench_cacheturn(&game, &list,
+						c == 0);
+				hive_makemove(&game, &played[h][m], &undo);
+			}
+			hive_free(&game);
+		}
+		elapsed[c] = bench_now() - start;
+	}
+	hive_init(&game);
+	cache->verify = true;
+	for (size_t h = 0; h < n; h++) {
+		hive_reset(&game);
+		for (size_t m = 0; m < numPlayed[h]; m++) {
+			hive_generatemoves(&game, cache, &tries);
+			for (size_t i = 0; i < tries.count; i += 1 +
+					tries.count / 4) {
+				hive_makemove(&game, &tries.moves[i], &undo);
+				bench_cacheturn(&game, &list, true);
+				hive_undomove(&game, &undo);
+			}
+			bench_cacheturn(&game, &list, true);
+			hive_makemove(&game, &played[h][m], &undo);
+		}
+	}
+	printf("move cache\t%10.1f us/turn\t(%zu)\n",
+			elapsed[0] * 1e6 / turns, found[0]);
+	printf("no cache\t%10.1f us/turn\t(%zu)\n",
+			elapsed[1] * 1e6 / turns, found[1]);
+	printf("cache hits\t%10.1f %%\t\t(%lu different)\n",
+			hive_cache_hitrate(cache), cache->mismatches);
+	hive_free(&game);
+	free(list.moves);
+	free(tries.moves);
+}
+
+/* taking a snapshot of a position and going back to it, as a state and
+ * as a copy of the whole game
+ */
+static void bench_state(Hive *hives, size_t n)
+{
+	const int rounds = 100;
+	static Hive game, copy;
+	HiveState *states, again;
+	size_t different = 0;
+	double get, copies, set, full, start;
+	volatile int sink = 0;
+
+	bench_checkhashes(hives, n);
+	states = malloc(sizeof(*states) * n);
+	if (states == NULL)
+		return;
+	hive_init(&game);
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++)
+			hive_getstate(&hives[h], &states[h]);
+	get = bench_now() - start;
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			memcpy(&again, &states[h], sizeof(again));
+			sink += memcmp(&again, &states[h], sizeof(again));
+		}
+	copies = bench_now() - start;
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++)
+			sink += hive_setstate(&game, &states[h]);
+	set = bench_now() - start;
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			sink += hive_copy(&copy, &hives[h]);
+			hive_free(&copy);
+		}
+	full = bench_now() - start;
+
+	for (size_t h = 0; h < n; h++) {
+		hive_setstate(&game, &states[h]);
+		hive_getstate(&game, &again);
+		if (memcmp(&again, &states[h], sizeof(again)) != 0 ||
+				game.hash != hives[h].hash)
+			different++;
+	}
+	printf("state size\t%10zu bytes\n", sizeof(HiveState));
+	printf("state get\t%10.1f ns/position\n", get * 1e9 / (rounds * n));
+	printf("state copy\t%10.1f ns/position\n",
+			copies * 1e9 / (rounds * n));
+	printf("state set\t%10.1f ns/position\t(%zu different)\n",
+			set * 1e9 / (rounds * n), different);
+	printf("hive copy\t%10.1f ns/position\n", full * 1e9 / (rounds * n));
+	hive_free(&game);
+	free(states);
+}
+
+/* puts the pieces of a position onto an empty game, turned, mirrored and
+ * moved by the symmetry
+ */
+static void bench_transform(Hive *dest, const Hive *src,
+		const HiveSymmetry *symmetry)
+{
+	const HiveRegion *const board = &src->board;
+
+	hive_reset(dest);
+	for (size_t i = 0; i < HIVE_CELL_COUNT; i++) {
+		const HiveCell *const cell = &board->cells[i];
+		const Point axial = hive_symmetry_apply(symmetry,
+				cell->position);
+		const Point at = { axial.x, axial.y + (axial.x >> 1) };
+
+		for (uint32_t l = 0; l < cell->count; l++) {
+			HivePiece *const piece = &dest->allPieces[
+				cell->stack[l] - src->allPieces];
+			hive_region_removepiece(piece->side == HIVE_WHITE ?
+					&dest->whiteInventory :
+					&dest->blackInventory, piece);
+			piece->position = at;
+			hive_region_addpiece(&dest->board, piece);
+		}
+	}
+	dest->turn = src->turn;
+	dest->hash = hive_computehash(dest);
+	hive_eval_compute(dest, &dest->eval);
+}
+
+/* checks that the canonical hash is the same for all turned and mirrored
+ * copies of a position and different for different positions
+ */
+static void bench_canonical(Hive *hives, size_t n)
+{
+	const int rounds = 100;
+	static Hive copy;
+	uint64_t *keys;
+	size_t different = 0, same = 0, plain = 0;
+	double canonical, hash, start;
+	volatile uint64_t sink = 0;
+
+	bench_checkhashes(hives, n);
+	keys = malloc(sizeof(*keys) * n);
+	if (keys == NULL)
+		return;
+	hive_init(&copy);
+	for (size_t h = 0; h < n; h++) {
+		keys[h] = hive_computecanonical(&hives[h], NULL);
+		for (uint32_t t = 0; t < 12; t++) {
+			const HiveSymmetry symmetry = {
+				.transform = t,
+				.origin = {
+					(int) (bench_random() % 41) - 20,
+					(int) (bench_random() % 41) - 20,
+				},
+			};
+			bench_transform(&copy, &hives[h], &symmetry);
+			if (hive_computecanonical(&copy, NULL) != keys[h])
+				different++;
+			if (t > 0 && copy.hash == hives[h].hash)
+				plain++;
+		}
+		for (size_t o = 0; o < h; o++)
+			if (keys[o] == keys[h])
+				same++;
+	}
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++)
+			sink += hive_computecanonical(&hives[h], NULL);
+	canonical = bench_now() - start;
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++)
+			sink += hive_computehash(&hives[h]);
+	hash = bench_now() - start;
+
+	printf("canonical\t%10.1f ns/position\t(%zu different, "
+			"%zu collisions)\n",
+			canonical * 1e9 / (rounds * n), different, same);
+	printf("hash\t\t%10.1f ns/position\t(%zu same)\n",
+			hash * 1e9 / (rounds * n), plain);
+	hive_free(&copy);
+	free(keys);
+}
+
+/* the features of all positions, one at a time from the pieces behind
+ * the pointers of the regions against the batch kernel, once with and
+ * once without turning the positions around first
+ */
+static void bench_batch(Hive *hives, size_t n)
+{
+	const int rounds = 200;
+	const size_t numBatches = (n + HIVE_BATCH_SIZE - 1) / HIVE_BATCH_SIZE;
+	const Hive **pointers;
+	HiveBatch *batches;
+	HiveBatchFeatures *features;
+	HiveEvalState eval;
+	size_t mismatches = 0;
+	double scalar, batched, kernel, start;
+	volatile int sink = 0;
+
+	bench_checkhashes(hives, n);
+	pointers = malloc(sizeof(*pointers) * n);
+	batches = aligned_alloc(16, sizeof(*batches) * numBatches);
+	features = aligned_alloc(16, sizeof(*features) * numBatches);
+	if (pointers == NULL || batches == NULL || features == NULL) {
+		printf("batch\t\tno memory\n");
+		free(pointers);
+		free(batches);
+		free(features);
+		return;
+	}
+	for (size_t h = 0; h < n; h++)
+		pointers[h] = &hives[h];
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t h = 0; h < n; h++) {
+			hive_eval_compute(&hives[h], &eval);
+			sink += eval.queenNeighbors[0] + eval.coveredBy[0] +
+				hives[h].blackInventory.numPieces;
+		}
+	scalar = bench_now() - start;
+
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		hive_evaluate_batch(pointers, n, features);
+	batched = bench_now() - start;
+
+	for (size_t b = 0; b < numBatches; b++)
+		hive_batch_load(&batches[b], &pointers[b * HIVE_BATCH_SIZE],
+				n - b * HIVE_BATCH_SIZE);
+	start = bench_now();
+	for (int r = 0; r < rounds; r++)
+		for (size_t b = 0; b < numBatches; b++)
+			hive_batch_features(&batches[b], &features[b]);
+	kernel = bench_now() - start;
+
+	for (size_t h = 0; h < n; h++) {
+		const HiveBatchFeatures *const f =
+			&features[h / HIVE_BATCH_SIZE];
+		const size_t l = h % HIVE_BATCH_SIZE;
+
+		hive_eval_compute(&hives[h], &eval);
+		for (int s = 0; s < 2; s++) {
+			const HiveRegion *const inventory = s == HIVE_WHITE ?
+				&hives[h].whiteInventory :
+				&hives[h].blackInventory;
+			if (f->queenNeighbors[s][l] !=
+					(int) eval.queenNeighbors[s] ||
+					f->coveredBy[s][l] != eval.coveredBy[s] ||
+					f->inventory[s][l] !=
+					(int) inventory->numPieces)
+				mismatches++;
+		}
+	}
+	printf("batch scalar\t%10.1f ns/position\n",
+			scalar * 1e9 / (rounds * n));
+	printf("batch\t\t%10.1f ns/position\t(%zu different)\n",
+			batched * 1e9 / (rounds * n), mismatches);
+	printf("batch kernel\t%10.1f ns/position\n",
+			kernel * 1e9 / (rounds * n));
+	free(pointers);
+	free(batches);
+	free(features);
+}
+
+/* writes a network of random weights of about the size a trained one
+ * would have
+ */
+static int bench_writennue(char *path)
+{
+	HiveNnueHeader header;
+	FILE *fp;
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		return -1;
+	fp = fdopen(fd, "wb");
+	if (fp == NULL) {
+		close(fd);
+		return -1;
+	}
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, HIVE_NNUE_MAGIC, sizeof(header.magic));
+	header.features = HIVE_NNUE_FEATURES;
+	header.hidden = HIVE_NNUE_HIDDEN;
+	header.hidden2 = HIVE_NNUE_HIDDEN2;
+	header.outputBias = 0;
+	fwrite(&header, sizeof(header), 1, fp);
+	for (size_t i = 0; i < HIVE_NNUE_FEATURES * HIVE_NNUE_HIDDEN; i++) {
+		const int16_t w = (int) (bench_random() % 33) - 16;
+		fwrite(&w, sizeof(w), 1, fp);
+	}
+	for (size_t i = 0; i < HIVE_NNUE_HIDDEN; i++) {
+		const int16_t b = bench_random() % 64;
+		fwrite(&b, sizeof(b), 1, fp);
+	}
+	for (size_t i = 0; i < HIVE_NNUE_HIDDEN2 * 2 * HIVE_NNUE_HIDDEN; i++) {
+		const int8_t w = (int) (bench_random() % 65) - 32;
+		fwrite(&w, sizeof(w), 1, fp);
+	}
+	for (size_t i = 0; i < HIVE_NNUE_HIDDEN2; i++) {
+		const int32_t b = (int) (bench_random() % 2049) - 1024;
+		fwrite(&b, sizeof(b), 1, fp);
+	}
+	for (size_t i = 0; i < HIVE_NNUE_HIDDEN2; i++) {
+		const int8_t w = (int) (bench_random() % 129) - 64;
+		fwrite(&w, sizeof(w), 1, fp);
+	}
+	return fclose(fp) == 0 ? 0 : -1;
+}
+
+/* evaluates the positions after each move with every kernel the
+ * processor has and compares them to the scalar one
+ */
+static void bench_nnue(Hive *hives, size_t n)
+{
+	static const char *const names[] = {
+		[HIVE_NNUE_SCALAR] = "scalar",
+		[HIVE_NNUE_SSSE3] = "ssse3",
+		[HIVE_NNUE_AVX2] = "avx2",
+	};
+	const int rounds = 20;
+	char path[] = "/tmp/hive-nnue-XXXXXX";
+	enum hive_nnue_kernel best;
+	HiveMoveList list;
+	HiveUndo undo;
+	double elapsed[ARRLEN(names)] = { 0 };
+	double refresh = 0, makes = 0;
+	size_t ops = 0, moves = 0, mismatches = 0;
+	volatile int sink = 0;
+
+	bench_checkhashes(hives, n);
+	if (bench_writennue(path) < 0) {
+		printf("nnue\t\tcan't write the network\n");
+		return;
+	}
+	if (hive_nnue_load(path) < 0) {
+		printf("nnue\t\tcan't load the network\n");
+		unlink(path);
+		return;
+	}
+	best = hive_nnue.kernel;
+	memset(&list, 0, sizeof(list));
+	for (size_t h = 0; h < n; h++) {
+		hive_nnue_refresh(&hives[h]);
+		hive_generatemoves(&hives[h], &hives[h].cache, &list);
+		double start = bench_now();
+		for (size_t i = 0; i < list.count; i++) {
+			hive_makemove(&hives[h], &list.moves[i], &undo);
+			hive_undomove(&hives[h], &undo);
+		}
+		makes += bench_now() - start;
+		moves += list.count;
+		for (size_t i = 0; i < list.count; i++) {
+			hive_makemove(&hives[h], &list.moves[i], &undo);
+			hive_nnue.kernel = HIVE_NNUE_SCALAR;
+			const int expected = hive_nnue_evaluate(&hives[h]);
+			for (int k = 0; k <= (int) best; k++) {
+				hive_nnue.kernel = k;
+				if (hive_nnue_evaluate(&hives[h]) != expected)
+					mismatches++;
+				start = bench_now();
+				for (int r = 0; r < rounds; r++)
+					sink += hive_nnue_evaluate(&hives[h]);
+				elapsed[k] += bench_now() - start;
+			}
+			start = bench_now();
+			for (int r = 0; r < rounds; r++) {
+				hive_nnue_refresh(&hives[h]);
+				sink += hive_nnue_evaluate(&hives[h]);
+			}
+			refresh += bench_now() - start;
+			hive_undomove(&hives[h], &undo);
+			ops += rounds;
+		}
+	}
+	for (int k = 0; k <= (int) best; k++)
+		printf("nnue %s\t%10.0f evals/s\n", names[k], ops / elapsed[k]);
+	printf("nnue refresh\t%10.0f evals/s\t(%zu different)\n",
+			ops / refresh, mismatches);
+	printf("nnue make/undo\t%10.1f ns/move\n", makes * 1e9 / moves);
+	free(list.moves);
+	hive_nnue_unload();
+	unlink(path);
+}
+
+int main(int argc, char **argv)
+{
+	static Hive hives[BENCH_POSITIONS];
+	const char *what;
+
+	what = argc > 1 ? argv[1] : "all";
+	for (size_t h = 0; h < ARRLEN(hives); h++) {
+		hive_init(&hives[h]);
+		bench_fillboard(&hives[h]);
+	}
+	printf("%zu full-board positions\n", ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "region")) {
+		bench_neighbors(hives, ARRLEN(hives));
+		bench_stacks(hives, ARRLEN(hives));
+		bench_count(hives, ARRLEN(hives));
+		bench_movegen(hives, ARRLEN(hives));
+		bench_generate(hives, ARRLEN(hives));
+		bench_makemove(hives, ARRLEN(hives));
+	}
+	if (!strcmp(what, "all") || !strcmp(what, "bitboard")) {
+		bench_places(hives, ARRLEN(hives));
+		bench_connected(hives, ARRLEN(hives));
+		bench_graph(hives, ARRLEN(hives));
+	}
+	if (!strcmp(what, "all") || !strcmp(what, "tables"))
+		bench_tables(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "table"))
+		bench_table(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "eval"))
+		bench_eval(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "cache"))
+		bench_cache(ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "state"))
+		bench_state(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "canonical"))
+		bench_canonical(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "batch"))
+		bench_batch(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "nnue"))
+		bench_nnue(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "search"))
+		bench_search(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "smp"))
+		bench_smp(hives, ARRLEN(hives));
+	if (!strcmp(what, "all") || !strcmp(what, "mcts"))
+		bench_mcts(hives, ARRLEN(hives));
+	return 0;
+}
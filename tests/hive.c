@@ -15,9 +15,12 @@ bool act_on_piece(Hive *hive, int c)
 		{ 't' },
 	};
 
+	Point pos;
+
 	HivePiece *const piece = hive->selectedPiece;
 	if (piece == NULL)
 		return false;
+	pos = piece->position;
 	switch (c) {
 	default: {
 		int d;
@@ -26,20 +29,20 @@ bool act_on_piece(Hive *hive, int c)
 				break;
 		if (d == (int) ARRLEN(keys))
 			return false;
-		hive_movepoint(&piece->position, d);
+		hive_movepoint(&pos, d);
 		break;
 	}
 	case KEY_LEFT:
-		piece->position.x--;
+		pos.x--;
 		break;
 	case KEY_UP:
-		piece->position.y--;
+		pos.y--;
 		break;
 	case KEY_RIGHT:
-		piece->position.x++;
+		pos.x++;
 		break;
 	case KEY_DOWN:
-		piece->position.y++;
+		pos.y++;
 		break;
 	case '+':
 		if (piece->type == 7)
@@ -61,6 +64,11 @@ bool act_on_piece(Hive *hive, int c)
 			HIVE_BLACK;
 		break;
 	}
+	if (!point_isequal(pos, piece->position))
+		hive_region_movepiece(hive->selectedRegion, piece, pos);
+	/* the pieces are edited behind the back of hive_makemove */
+	hive_eval_compute(hive, &hive->eval);
+	hive_cache_clear(hive);
 	hive_computemoves(hive, piece->type);
 	return true;
 }
@@ -166,6 +174,8 @@ int main(void)
 						hive_region_removepiece(&hive->board,
 							hive_region_pieceatr(&hive->board, NULL, p));
 					}
+					hive_eval_compute(hive, &hive->eval);
+					hive_cache_clear(hive);
 				}
 			}
 			break;
@@ -0,0 +1,504 @@
+#include "test.h"
+
+#include <time.h>
+
+/* usage: perft [-j threads] [-2] [-H megabytes] <depth> [moves]
+ * the moves are in the format of the network protocol (see hive.h) and
+ * separated by ';' or new lines, "-" reads them from stdin;
+ * with more than one thread the moves of the root (and of the second ply
+ * with -2) are split between the threads and the count is done once more
+ * on a single thread to compare against
+ */
+
+#define PERFT_MAX_DEPTH 32
+#define PERFT_MAX_THREADS 256
+
+/* Node counts of subtrees keyed by the hash of the position and the
+ * depth. Like the transposition table, the key is stored xor'ed with the
+ * count so that threads can share it without locks.
+ */
+struct perft_memo {
+	struct perft_memo_entry {
+		uint64_t check;
+		uint64_t nodes;
+	} *entries;
+	size_t numEntries;
+};
+
+/* a root move, or a root move and one answer to it */
+struct perft_task {
+	size_t root;
+	uint32_t numMoves;
+	HiveMove moves[2];
+};
+
+/* The tasks of a worker are a stack, the worker itself takes from the
+ * top and the others steal from the bottom once they are out of tasks.
+ */
+struct perft_deque {
+	pthread_mutex_t lock;
+	struct perft_task *tasks;
+	size_t bottom, top;
+};
+
+struct perft_worker {
+	pthread_t thread;
+	bool isRunning;
+	struct perft_run *run;
+	uint32_t id;
+	Hive hive;
+	HiveMoveList lists[PERFT_MAX_DEPTH];
+	struct perft_deque deque;
+	uint64_t nodes;
+	uint32_t steals;
+};
+
+struct perft_run {
+	const Hive *hive;
+	uint32_t depth;
+	struct perft_memo *memo;
+	struct perft_worker *workers;
+	uint32_t numWorkers;
+	/* leaves below each root move */
+	uint64_t *divide;
+};
+
+static double perft_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int perft_memo_init(struct perft_memo *memo, size_t megabytes)
+{
+	memo->numEntries = 0;
+	memo->entries = NULL;
+	if (megabytes == 0)
+		return 0;
+	memo->numEntries = 1;
+	while ((memo->numEntries << 1) * sizeof(*memo->entries) <=
+			megabytes << 20)
+		memo->numEntries <<= 1;
+	memo->entries = calloc(memo->numEntries, sizeof(*memo->entries));
+	return memo->entries == NULL ? -1 : 0;
+}
+
+static uint64_t perft_memo_key(uint64_t hash, uint32_t depth)
+{
+	return hash ^ (depth * 0x9e3779b97f4a7c15);
+}
+
+static bool perft_memo_probe(struct perft_memo *memo, uint64_t key,
+		uint64_t *nodes)
+{
+	struct perft_memo_entry *entry;
+	uint64_t check, n;
+
+	if (memo->numEntries == 0)
+		return false;
+	entry = &memo->entries[key & (memo->numEntries - 1)];
+	check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+	n = __atomic_load_n(&entry->nodes, __ATOMIC_RELAXED);
+	if (n == 0 || (check ^ n) != key)
+		return false;
+	*nodes = n;
+	return true;
+}
+
+static void perft_memo_store(struct perft_memo *memo, uint64_t key,
+		uint64_t nodes)
+{
+	struct perft_memo_entry *entry;
+
+	if (memo->numEntries == 0 || nodes == 0)
+		return;
+	entry = &memo->entries[key & (memo->numEntries - 1)];
+	__atomic_store_n(&entry->check, key ^ nodes, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->nodes, nodes, __ATOMIC_RELAXED);
+}
+
+static bool perft_isover(const Hive *hive)
+{
+	return hive_issurrounded(hive, HIVE_WHITE) ||
+		hive_issurrounded(hive, HIVE_BLACK);
+}
+
+static void perft_pass(Hive *hive)
+{
+	hive->turn = hive->turn == HIVE_WHITE ? HIVE_BLACK : HIVE_WHITE;
+	hive->hash ^= hive_hash_turn();
+}
+
+/* Counts the leaves depth moves away. A side without moves passes and the
+ * pass counts as a move, a finished game has no moves at all. Repetitions
+ * are not looked at, so the count only depends on the position.
+ */
+static uint64_t perft(struct perft_worker *w, uint32_t depth)
+{
+	Hive *const hive = &w->hive;
+	HiveMoveList *const list = &w->lists[depth];
+	HiveUndo undo;
+	uint64_t nodes = 0;
+	uint64_t key;
+
+	assert(hive->hash == hive_computehash(hive));
+	if (depth == 0)
+		return 1;
+	if (perft_isover(hive))
+		return 0;
+	/* the last ply is counted without playing it, that is cheaper than
+	 * looking it up
+	 */
+	key = perft_memo_key(hive->hash, depth);
+	if (depth > 1 && perft_memo_probe(w->run->memo, key, &nodes))
+		return nodes;
+	hive_generatemoves(hive, NULL, list);
+	if (list->count == 0) {
+		perft_pass(hive);
+		nodes = perft(w, depth - 1);
+		perft_pass(hive);
+	} else if (depth == 1) {
+		return list->count;
+	} else {
+		for (size_t i = 0; i < list->count; i++) {
+			hive_makemove(hive, &list->moves[i], &undo);
+			nodes += perft(w, depth - 1);
+			hive_undomove(hive, &undo);
+		}
+	}
+	if (depth > 1)
+		perft_memo_store(w->run->memo, key, nodes);
+	return nodes;
+}
+
+static bool perft_pop(struct perft_worker *w, struct perft_task *task)
+{
+	struct perft_deque *const deque = &w->deque;
+	bool found = false;
+
+	pthread_mutex_lock(&deque->lock);
+	if (deque->top > deque->bottom) {
+		*task = deque->tasks[--deque->top];
+		found = true;
+	}
+	pthread_mutex_unlock(&deque->lock);
+	return found;
+}
+
+static bool perft_steal(struct perft_worker *w, struct perft_task *task)
+{
+	struct perft_run *const run = w->run;
+
+	for (uint32_t i = 1; i < run->numWorkers; i++) {
+		struct perft_deque *const deque =
+			&run->workers[(w->id + i) % run->numWorkers].deque;
+		bool found = false;
+
+		pthread_mutex_lock(&deque->lock);
+		if (deque->top > deque->bottom) {
+			*task = deque->tasks[deque->bottom++];
+			found = true;
+		}
+		pthread_mutex_unlock(&deque->lock);
+		if (found) {
+			w->steals++;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void *perft_work(void *arg)
+{
+	struct perft_worker *const w = arg;
+	struct perft_task task;
+	HiveUndo undos[2];
+	uint64_t nodes;
+
+	/* no new tasks come up while working, so once all deques are
+	 * empty everything is done
+	 */
+	while (perft_pop(w, &task) || perft_steal(w, &task)) {
+		for (uint32_t m = 0; m < task.numMoves; m++)
+			hive_makemove(&w->hive, &task.moves[m], &undos[m]);
+		nodes = perft(w, w->run->depth - task.numMoves);
+		for (uint32_t m = task.numMoves; m-- != 0; )
+			hive_undomove(&w->hive, &undos[m]);
+		__atomic_fetch_add(&w->run->divide[task.root], nodes,
+				__ATOMIC_RELAXED);
+		w->nodes += nodes;
+	}
+	return NULL;
+}
+
+static void perft_addtask(struct perft_run *run, size_t *next,
+		const struct perft_task *task)
+{
+	struct perft_deque *const deque =
+		&run->workers[*next % run->numWorkers].deque;
+
+	deque->tasks[deque->top++] = *task;
+	(*next)++;
+}
+
+/* the tasks are dealt out in turn like cards */
+static int perft_maketasks(struct perft_run *run, const HiveMoveList *root,
+		bool splitSecond)
+{
+	Hive *const hive = &run->workers[0].hive;
+	HiveMoveList replies;
+	struct perft_task task;
+	HiveUndo undo;
+	size_t numTasks = root->count;
+	size_t next = 0;
+
+	memset(&replies, 0, sizeof(replies));
+	if (splitSecond) {
+		numTasks = 0;
+		for (size_t i = 0; i < root->count; i++) {
+			hive_makemove(hive, &root->moves[i], &undo);
+			hive_generatemoves(hive, NULL, &replies);
+			numTasks += MAX(replies.count, (size_t) 1);
+			hive_undomove(hive, &undo);
+		}
+	}
+	for (uint32_t i = 0; i < run->numWorkers; i++) {
+		struct perft_deque *const deque = &run->workers[i].deque;
+		deque->tasks = malloc(sizeof(*deque->tasks) * numTasks);
+		if (deque->tasks == NULL)
+			return -1;
+	}
+
+	for (size_t i = 0; i < root->count; i++) {
+		task.root = i;
+		task.moves[0] = root->moves[i];
+		task.numMoves = 1;
+		if (!splitSecond || run->depth < 2) {
+			perft_addtask(run, &next, &task);
+			continue;
+		}
+		hive_makemove(hive, &root->moves[i], &undo);
+		hive_generatemoves(hive, NULL, &replies);
+		/* passes and finished games are not split */
+		if (replies.count == 0 || perft_isover(hive))
+			perft_addtask(run, &next, &task);
+		task.numMoves = 2;
+		for (size_t j = 0; j < replies.count && !perft_isover(hive);
+				j++) {
+			task.moves[1] = replies.moves[j];
+			perft_addtask(run, &next, &task);
+		}
+		hive_undomove(hive, &undo);
+	}
+	free(replies.moves);
+	return 0;
+}
+
+/* counts the leaves below each root move, returns the elapsed time or a
+ * negative value if something could not be allocated
+ */
+static double perft_divide(const Hive *hive, const HiveMoveList *root,
+		uint32_t depth, uint32_t numThreads, bool splitSecond,
+		size_t memoSize, uint64_t *divide)
+{
+	struct perft_run run;
+	struct perft_memo memo;
+	double elapsed = -1;
+
+	if (perft_memo_init(&memo, memoSize) < 0)
+		return -1;
+	run.hive = hive;
+	run.depth = depth;
+	run.memo = &memo;
+	run.numWorkers = numThreads;
+	run.divide = divide;
+	memset(divide, 0, sizeof(*divide) * root->count);
+	run.workers = calloc(numThreads, sizeof(*run.workers));
+	if (run.workers == NULL)
+		goto end;
+	for (uint32_t i = 0; i < numThreads; i++) {
+		struct perft_worker *const w = &run.workers[i];
+		w->run = &run;
+		w->id = i;
+		pthread_mutex_init(&w->deque.lock, NULL);
+		if (hive_copy(&w->hive, hive) < 0)
+			goto end;
+	}
+
+	const double start = perft_now();
+	if (perft_maketasks(&run, root, splitSecond) < 0)
+		goto end;
+	/* if a thread can't be started, the others steal its tasks */
+	for (uint32_t i = 1; i < numThreads; i++)
+		run.workers[i].isRunning = pthread_create(
+				&run.workers[i].thread, NULL, perft_work,
+				&run.workers[i]) == 0;
+	perft_work(&run.workers[0]);
+	for (uint32_t i = 1; i < numThreads; i++)
+		if (run.workers[i].isRunning)
+			pthread_join(run.workers[i].thread, NULL);
+	elapsed = perft_now() - start;
+
+	if (numThreads > 1)
+		for (uint32_t i = 0; i < numThreads; i++)
+			printf("thread %u\t%lu nodes\t%u steals\n", i,
+					run.workers[i].nodes,
+					run.workers[i].steals);
+
+end:
+	if (run.workers != NULL)
+		for (uint32_t i = 0; i < numThreads; i++) {
+			struct perft_worker *const w = &run.workers[i];
+			for (size_t l = 0; l < ARRLEN(w->lists); l++)
+				free(w->lists[l].moves);
+			free(w->deque.tasks);
+			pthread_mutex_destroy(&w->deque.lock);
+			hive_free(&w->hive);
+		}
+	free(run.workers);
+	free(memo.entries);
+	return elapsed;
+}
+
+static char *perft_readall(FILE *fp)
+{
+	char *data = NULL;
+	size_t len = 0, cap = 0;
+	size_t n;
+
+	do {
+		if (len + 256 > cap) {
+			cap = cap * 2 + 256;
+			data = realloc(data, cap);
+			if (data == NULL)
+				return NULL;
+		}
+		n = fread(&data[len], 1, cap - len - 1, fp);
+		len += n;
+	} while (n > 0);
+	data[len] = '\0';
+	return data;
+}
+
+static void perft_usage(const char *program)
+{
+	fprintf(stderr, "usage: %s [-j threads] [-2] [-H megabytes] "
+			"<depth> [moves|-]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+	static Hive hive;
+	HiveMoveList root;
+	char *moves, *bad;
+	uint32_t depth;
+	uint32_t numThreads = 1;
+	bool splitSecond = false;
+	size_t memoSize = 16;
+	uint64_t *divide, *single;
+	uint64_t total = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "j:2H:")) != -1)
+		switch (opt) {
+		case 'j':
+			numThreads = strtoul(optarg, NULL, 10);
+			break;
+		case '2':
+			splitSecond = true;
+			break;
+		case 'H':
+			memoSize = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			perft_usage(argv[0]);
+			return 1;
+		}
+	if (optind + 1 != argc && optind + 2 != argc) {
+		perft_usage(argv[0]);
+		return 1;
+	}
+	depth = strtoul(argv[optind], NULL, 10);
+	if (depth == 0 || depth >= PERFT_MAX_DEPTH) {
+		fprintf(stderr, "depth must be between 1 and %d\n",
+				PERFT_MAX_DEPTH - 1);
+		return 1;
+	}
+	if (numThreads == 0 || numThreads > PERFT_MAX_THREADS) {
+		fprintf(stderr, "threads must be between 1 and %d\n",
+				PERFT_MAX_THREADS);
+		return 1;
+	}
+	hive_init(&hive);
+	if (optind + 2 == argc) {
+		moves = strcmp(argv[optind + 1], "-") == 0 ?
+			perft_readall(stdin) : strdup(argv[optind + 1]);
+		if (moves == NULL)
+			return 1;
+		if (hive_loadmoves(&hive, moves, &bad) < 0) {
+			fprintf(stderr, "invalid or illegal move '%s'\n", bad);
+			return 1;
+		}
+		free(moves);
+	}
+
+	memset(&root, 0, sizeof(root));
+	hive_generatemoves(&hive, NULL, &root);
+	if (root.count == 0 || perft_isover(&hive)) {
+		/* nothing to split, count the pass or the finished game */
+		static struct perft_worker w;
+		struct perft_run run = { .depth = depth };
+		struct perft_memo memo = { 0 };
+
+		run.memo = &memo;
+		w.run = &run;
+		if (hive_copy(&w.hive, &hive) < 0)
+			return 1;
+		printf("nodes\t%lu\n", perft(&w, depth));
+		return 0;
+	}
+
+	divide = malloc(sizeof(*divide) * root.count);
+	single = malloc(sizeof(*single) * root.count);
+	if (divide == NULL || single == NULL)
+		return 1;
+	const double elapsed = perft_divide(&hive, &root, depth, numThreads,
+			splitSecond, memoSize, divide);
+	if (elapsed < 0) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for (size_t i = 0; i < root.count; i++) {
+		printf("%s: %lu\n", hive_serializemove(&root.moves[i]),
+				divide[i]);
+		total += divide[i];
+	}
+	printf("\nnodes\t%lu\n", total);
+	printf("time\t%.3f s\n", elapsed);
+	printf("speed\t%.0f nodes/s\n", elapsed > 0 ? total / elapsed : 0);
+
+	/* the same count on one thread as the base for the scaling */
+	if (numThreads > 1) {
+		const double base = perft_divide(&hive, &root, depth, 1, false,
+				memoSize, single);
+		if (base < 0) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		for (size_t i = 0; i < root.count; i++)
+			if (single[i] != divide[i])
+				printf("mismatch for %s: %lu on one thread\n",
+					hive_serializemove(&root.moves[i]),
+					single[i]);
+		printf("single\t%.3f s\n", base);
+		printf("speedup\t%.2f\n", base / elapsed);
+		printf("scaling\t%.0f %%\n",
+				100 * base / elapsed / numThreads);
+	}
+	free(divide);
+	free(single);
+	free(root.moves);
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include "test.h"
+
+#include <time.h>
+
+/* usage: solve [-n moves] [-N nodes] [-H megabytes] [moves]
+ * plays the moves (see perft.c) and then tries to prove that the side to
+ * move surrounds the other queen within the given number of its moves
+ */
+
+static void solve_usage(const char *program)
+{
+	fprintf(stderr, "usage: %s [-n moves] [-N nodes] [-H megabytes] "
+			"[moves]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+	static Hive hive;
+	static HiveSolver solver;
+	uint32_t numMoves = 2;
+	uint64_t maxNodes = 0;
+	size_t megabytes = 16;
+	HiveMove move;
+	enum hive_proof proof;
+	struct timespec start, end;
+	char *moves, *bad;
+	double elapsed;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:N:H:")) != -1)
+		switch (opt) {
+		case 'n':
+			numMoves = strtoul(optarg, NULL, 10);
+			break;
+		case 'N':
+			maxNodes = strtoull(optarg, NULL, 10);
+			break;
+		case 'H':
+			megabytes = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			solve_usage(argv[0]);
+			return 1;
+		}
+	if (optind + 1 < argc || numMoves == 0 || numMoves > HIVE_MAX_PLY) {
+		solve_usage(argv[0]);
+		return 1;
+	}
+	hive_init(&hive);
+	if (optind < argc) {
+		moves = strdup(argv[optind]);
+		if (moves == NULL)
+			return 1;
+		if (hive_loadmoves(&hive, moves, &bad) < 0) {
+			fprintf(stderr, "invalid or illegal move '%s'\n", bad);
+			return 1;
+		}
+		free(moves);
+	}
+	if (hive_solver_init(&solver, megabytes) < 0) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	proof = hive_solve(&solver, &hive, numMoves, maxNodes, &move);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	switch (proof) {
+	case HIVE_PROOF_WIN:
+		printf("win\t%s\n", hive_serializemove(&move));
+		break;
+	case HIVE_PROOF_NOWIN:
+		printf("no win\n");
+		break;
+	default:
+		printf("unknown\n");
+	}
+	printf("nodes\t%lu\n", solver.nodes);
+	printf("time\t%.3f s\n", elapsed);
+	hive_solver_free(&solver);
+	hive_free(&hive);
+	return 0;
+}